@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+
+#include "ceres/ceres.h"
+
+// As MyCostFunc, but the target (10 in MyCostFunc) is read from the caller's
+// buffer at each evaluation, so the problem can be solved again on a new
+// measurement without being rebuilt.
+struct MyMeasuredCostFunc {
+  explicit MyMeasuredCostFunc(const double* target) : target(target) {}
+
+  template <typename T>
+  bool operator()(const T* const x, T* residual) const {
+    residual[0] = *target - x[0];
+    return true;
+  }
+
+  const double* target;
+};
+
+// Repeated solves of the HelloCeres problem on new measurements: the problem
+// (and its cost function) is built once around the measurement buffer. Write
+// the new measurement with mutable_measurement(), then Solve(). Only the
+// construction is saved, ceres::Solve() still validates the options, runs its
+// preprocessor and allocates its workspace at each call.
+class MyRepeatedSolver {
+ public:
+  explicit MyRepeatedSolver(const ceres::Solver::Options& options)
+      : options_(options) {
+    problem_.AddResidualBlock(
+        new ceres::AutoDiffCostFunction<MyMeasuredCostFunc, 1, 1>(
+            new MyMeasuredCostFunc(&measurement_)),
+        NULL, &x_);
+    std::string error;
+    CHECK(options_.IsValid(&error)) << error;  // fail early, not at the first Solve()
+  }
+
+  double* mutable_measurement() { return &measurement_; }
+  double x() const { return x_; }
+
+  // Starts from initial_x, or from the previous solution with warm_start.
+  void Solve(double initial_x, bool warm_start, ceres::Solver::Summary* summary) {
+    if (!warm_start)
+      x_ = initial_x;
+    ceres::Solve(options_, &problem_, summary);
+  }
+
+ private:
+  double measurement_ = 10.0;
+  double x_ = 0.0;
+  ceres::Problem problem_;
+  ceres::Solver::Options options_;
+};
@@ -1,25 +1,14 @@
 #include "ceres/ceres.h"
 #include "glog/logging.h"
 
+#include "MyCostFunc.h"
+
 using ceres::AutoDiffCostFunction;
 using ceres::CostFunction;
 using ceres::Problem;
 using ceres::Solve;
 using ceres::Solver;
 
-// A templated cost functor that implements the residual r = 10 -
-// x. The method operator() is templated so that we can then use an
-// automatic differentiation wrapper around it to generate its
-// derivatives.
-struct MyCostFunc {
-  template <typename T>
-  bool operator()(const T* const x, T* residual) const {
-    residual[0] = 10.0 - x[0];
-    return true;
-  }
-};
-
-
 int main(int argc, char** argv) {
 
     google::InitGoogleLogging(argv[0]);
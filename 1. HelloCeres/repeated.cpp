@@ -0,0 +1,60 @@
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#include "ceres/ceres.h"
+#include "glog/logging.h"
+
+#include "MyRepeatedSolver.h"
+
+using ceres::AutoDiffCostFunction;
+using ceres::Problem;
+using ceres::Solver;
+
+// Solves the HelloCeres problem on a new measurement each time, with the
+// problem built once (MyRepeatedSolver), and rebuilt for each solve as in
+// main.cpp, and prints the per-solve latency of both.
+//
+// $ ./build/repeated [number of solves, default 10000]
+int main(int argc, char** argv) {
+
+    google::InitGoogleLogging(argv[0]);
+    const int num_solves = (argc > 1) ? std::max(1, atoi(argv[1])) : 10000;
+
+    Solver::Options options;
+    options.linear_solver_type = ceres::DENSE_QR;
+    options.logging_type = ceres::SILENT;
+
+    MyRepeatedSolver repeated_solver(options);
+    double prepared_time = 0.0, rebuilt_time = 0.0;
+    double prepared_preprocessor_time = 0.0, rebuilt_preprocessor_time = 0.0;
+    for (int k = 0; k < num_solves; ++k) {
+        const double measurement = 10.0 + 0.001 * k;
+
+        auto start = std::chrono::steady_clock::now();
+        *repeated_solver.mutable_measurement() = measurement;
+        Solver::Summary summary;
+        repeated_solver.Solve(5.0, false, &summary);
+        prepared_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        prepared_preprocessor_time += summary.preprocessor_time_in_seconds;
+
+        start = std::chrono::steady_clock::now();
+        double x = 5.0;
+        Problem problem;
+        problem.AddResidualBlock(
+            new AutoDiffCostFunction<MyMeasuredCostFunc, 1, 1>(new MyMeasuredCostFunc(&measurement)),
+            NULL, &x);
+        Solve(options, &problem, &summary);
+        rebuilt_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        rebuilt_preprocessor_time += summary.preprocessor_time_in_seconds;
+    }
+
+    std::cout << num_solves << " solves, x -> " << repeated_solver.x() << "\n"
+              << "  built once       : " << 1e6 * prepared_time / num_solves << " us per solve (preprocessor "
+              << 1e6 * prepared_preprocessor_time / num_solves << " us)\n"
+              << "  rebuilt per solve: " << 1e6 * rebuilt_time / num_solves << " us per solve (preprocessor "
+              << 1e6 * rebuilt_preprocessor_time / num_solves << " us)\n";
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "ceres/ceres.h"
+
+#include "MiniBatch/MiniBatch.h"
+
+#include "Models.h"
+
+// Stochastic mini-batch warm phase for very large datasets: the early LM iterations only need a rough gradient, 
+// thus the first phases solve a few iterations on growing random subsets of the samples (resampled in each phase), 
+// and only the final phase runs on the full dataset, starting from the warm parameters.
+// The options, the phase statistics and timeToCost are shared with 3. SimpleBA (MiniBatch/MiniBatch.h of the repository root).
+using minibatch::MiniBatchOptions;
+using minibatch::MiniBatchPhaseStats;
+using minibatch::timeToCost;
+
+struct MiniBatchResult {
+  CurveFitResult full_fit;                 // the final phase, on the full dataset
+  std::vector<MiniBatchPhaseStats> phases; // the final phase included
+  double time_in_seconds {0.0};
+};
+
+inline MiniBatchResult miniBatchFit(const CurveModelRegistry::Entry& _model, const double* _data, int _num_samples, bool _robust,
+                                    const ceres::Solver::Options& _solver_options, const MiniBatchOptions& _options)
+{
+  const auto start_time = std::chrono::steady_clock::now();
+  MiniBatchResult result;
+
+  std::vector<double> parameters(_model.num_parameters);
+  _model.initial_guess(parameters.data());
+
+  ceres::Solver::Options phase_options = _solver_options;
+  phase_options.max_num_iterations = _options.phase_max_iterations;
+  phase_options.minimizer_progress_to_stdout = false;
+
+  std::mt19937 random(_options.seed);
+  std::vector<int> indices(_num_samples);
+  std::iota(indices.begin(), indices.end(), 0);
+  std::vector<double> subset;
+
+  for (double fraction = _options.initial_fraction; fraction < 1.0; fraction *= std::max(_options.growth, 1.0 + 1e-3)) {
+    const int batch_size = std::max(_options.min_batch_size, static_cast<int>(std::ceil(fraction * _num_samples)));
+    if (batch_size >= _num_samples)
+      break;
+    const auto phase_start = std::chrono::steady_clock::now();
+
+    // a fresh sample without replacement (partial Fisher-Yates), gathered into a contiguous buffer
+    subset.resize(2 * batch_size);
+    for (int i = 0; i < batch_size; ++i) {
+      std::uniform_int_distribution<int> pick(i, _num_samples - 1);
+      std::swap(indices[i], indices[pick(random)]);
+      subset[2*i] = _data[2*indices[i]];
+      subset[2*i + 1] = _data[2*indices[i] + 1];
+    }
+
+    CurveFitResult phase = _model.fit(subset.data(), batch_size, _robust, phase_options, parameters.data());
+    if (phase.summary.IsSolutionUsable())
+      parameters = phase.parameters;
+
+    result.phases.push_back(MiniBatchPhaseStats {batch_size, static_cast<int>(phase.summary.iterations.size()),
+                                                 std::chrono::duration<double>(std::chrono::steady_clock::now() - phase_start).count(),
+                                                 phase.summary.final_cost});
+  }
+
+  const auto final_start = std::chrono::steady_clock::now();
+  result.full_fit = _model.fit(_data, _num_samples, _robust, _solver_options, parameters.data());
+  result.phases.push_back(MiniBatchPhaseStats {_num_samples, static_cast<int>(result.full_fit.summary.iterations.size()),
+                                               std::chrono::duration<double>(std::chrono::steady_clock::now() - final_start).count(),
+                                               result.full_fit.summary.final_cost});
+  result.time_in_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+  return result;
+}
+
+// A large synthetic dataset of the same model as data.h, y = exp(0.3 x + 0.1) + N(0, 0.2^2), x in [0, 5], x and y interleaved.
+inline std::vector<double> generateExponentialData(int _num_samples, unsigned int _seed = 23497) {
+  std::mt19937 random(_seed);
+  std::normal_distribution<double> noise(0.0, 0.2);
+  std::vector<double> samples(2 * static_cast<size_t>(_num_samples));
+  for (int i = 0; i < _num_samples; ++i) {
+    const double x = 5.0 * i / std::max(1, _num_samples - 1);
+    samples[2*i] = x;
+    samples[2*i + 1] = std::exp(0.3 * x + 0.1) + noise(random);
+  }
+  return samples;
+}
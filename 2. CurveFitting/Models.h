@@ -0,0 +1,284 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ceres/ceres.h"
+#include "ceres/loss_function.h"
+#include "Eigen/Core"
+
+// A library of curve models y = f(x; p). Each model declares its number of parameters at compile time, thus
+//  - the per-sample residual is a fixed-size AutoDiffCostFunction (all the parameters in one block),
+//  - the batched residual evaluates a whole dataset in one cost function, with Eigen arrays for the residuals and fixed-size jets for the jacobian,
+//  - and the runtime selector (see CurveModelRegistry) dispatches once per fit, never inside the per-sample loop.
+//
+// A model is a struct with
+//   static constexpr int kNumParameters;
+//   static const char* Name();
+//   static void InitialGuess(double* p);
+//   template <typename T> static T Evaluate(const T* p, double x);
+//   static void EvaluateBatch(const double* p, const Eigen::ArrayXd& x, Eigen::Map<Eigen::ArrayXd> y); // y = f(x; p) of all the samples
+
+struct ExponentialModel { // y = exp(m*x + c), as MyExponentialResidual
+  static constexpr int kNumParameters = 2;
+  static const char* Name() { return "exponential"; }
+  static void InitialGuess(double* p) { p[0] = 1.0; p[1] = 1.0; }
+
+  template <typename T>
+  static T Evaluate(const T* p, double x) {
+    using std::exp;
+    return exp(p[0] * x + p[1]);
+  }
+
+  static void EvaluateBatch(const double* p, const Eigen::ArrayXd& x, Eigen::Map<Eigen::ArrayXd> y) {
+    y = (p[0] * x + p[1]).exp();
+  }
+};
+
+template <int kDegree>
+struct PolynomialModel { // y = p0 + p1*x + ... + pn*x^n
+  static constexpr int kNumParameters = kDegree + 1;
+  static const char* Name() { static const std::string name = "poly" + std::to_string(kDegree); return name.c_str(); }
+  static void InitialGuess(double* p) { for (int i = 0; i < kNumParameters; ++i) p[i] = 0.0; }
+
+  template <typename T>
+  static T Evaluate(const T* p, double x) { // Horner
+    T y = p[kDegree];
+    for (int i = kDegree - 1; i >= 0; --i)
+      y = y * x + p[i];
+    return y;
+  }
+
+  static void EvaluateBatch(const double* p, const Eigen::ArrayXd& x, Eigen::Map<Eigen::ArrayXd> y) {
+    y.setConstant(p[kDegree]);
+    for (int i = kDegree - 1; i >= 0; --i)
+      y = y * x + p[i];
+  }
+};
+
+struct GaussianModel { // y = a * exp(-(x - mu)^2 / (2 sigma^2))
+  static constexpr int kNumParameters = 3;
+  static const char* Name() { return "gaussian"; }
+  static void InitialGuess(double* p) { p[0] = 1.0; p[1] = 0.0; p[2] = 1.0; }
+
+  template <typename T>
+  static T Evaluate(const T* p, double x) {
+    using std::exp;
+    const T d = (x - p[1]) / p[2];
+    return p[0] * exp(-0.5 * d * d);
+  }
+
+  static void EvaluateBatch(const double* p, const Eigen::ArrayXd& x, Eigen::Map<Eigen::ArrayXd> y) {
+    y = p[0] * (-0.5 / (p[2] * p[2]) * (x - p[1]).square()).exp();
+  }
+};
+
+template <int kNumTerms>
+struct SumOfExponentialsModel { // y = a0*exp(b0*x) + ... (parameters a0, b0, a1, b1, ...)
+  static constexpr int kNumParameters = 2 * kNumTerms;
+  static const char* Name() { static const std::string name = "sumexp" + std::to_string(kNumTerms); return name.c_str(); }
+  static void InitialGuess(double* p) { 
+    for (int k = 0; k < kNumTerms; ++k) { p[2*k] = 1.0 / kNumTerms; p[2*k + 1] = 0.1 * (k + 1); } // distinct rates, or the terms stay identical
+  }
+
+  template <typename T>
+  static T Evaluate(const T* p, double x) {
+    using std::exp;
+    T y = p[0] * exp(p[1] * x);
+    for (int k = 1; k < kNumTerms; ++k)
+      y += p[2*k] * exp(p[2*k + 1] * x);
+    return y;
+  }
+
+  static void EvaluateBatch(const double* p, const Eigen::ArrayXd& x, Eigen::Map<Eigen::ArrayXd> y) {
+    y = p[0] * (p[1] * x).exp();
+    for (int k = 1; k < kNumTerms; ++k)
+      y += p[2*k] * (p[2*k + 1] * x).exp();
+  }
+};
+
+struct LogisticModel { // y = L / (1 + exp(-k (x - x0)))
+  static constexpr int kNumParameters = 3;
+  static const char* Name() { return "logistic"; }
+  static void InitialGuess(double* p) { p[0] = 1.0; p[1] = 1.0; p[2] = 0.0; }
+
+  template <typename T>
+  static T Evaluate(const T* p, double x) {
+    using std::exp;
+    return p[0] / (1.0 + exp(-p[1] * (x - p[2])));
+  }
+
+  static void EvaluateBatch(const double* p, const Eigen::ArrayXd& x, Eigen::Map<Eigen::ArrayXd> y) {
+    y = p[0] / (1.0 + (-p[1] * (x - p[2])).exp());
+  }
+};
+
+
+// r = y - f(x; p) of one sample, with all the parameters of the model in one block.
+template <typename Model>
+struct ModelResidual {
+  ModelResidual(double x, double y) : x_(x), y_(y) {}
+
+  template <typename T>
+  bool operator()(const T* const p, T* residual) const {
+    residual[0] = y_ - Model::Evaluate(p, x_);
+    return true;
+  }
+
+  static ceres::CostFunction* Create(double _x, double _y) {
+    return ( new ceres::AutoDiffCostFunction<
+               ModelResidual, 
+               1 /*kNumResiduals*/, 
+               Model::kNumParameters /* Size of the parameter block */ >(new ModelResidual(_x, _y)) );
+  }
+
+private:
+  const double x_;
+  const double y_;
+};
+
+// The residuals of a whole dataset (one per sample) in a single cost function. The samples are kept as contiguous x and y arrays:
+//  - the residual-only evaluations (every trial step of the solver) run on whole Eigen arrays (Model::EvaluateBatch) in an AVX build,
+//    where the vectorized exp() of Eigen takes 4 doubles at once. With SSE2 only (2 doubles), it is no faster than the scalar loop,
+//    which is kept for such builds,
+//  - the jacobian evaluations run a scalar loop on fixed-size jets, free of any dispatch.
+// Note that a loss function would apply to the whole block, thus this is for the squared loss only.
+template <typename Model>
+class BatchedModelCostFunction : public ceres::CostFunction {
+public:
+  static constexpr int N = Model::kNumParameters;
+  typedef ceres::Jet<double, N> JetT;
+
+public:
+  BatchedModelCostFunction(const double* _data, int _num_samples) // _data: x and y interleaved, as data.h
+  : x_(_num_samples), y_(_num_samples) {
+    for (int i = 0; i < _num_samples; ++i) {
+      x_[i] = _data[2*i];
+      y_[i] = _data[2*i + 1];
+    }
+    set_num_residuals(_num_samples);
+    mutable_parameter_block_sizes()->push_back(N);
+  }
+
+  bool Evaluate(double const* const* parameters, double* residuals, double** jacobians) const override {
+    const double* p = parameters[0];
+    const int num_samples = static_cast<int>(x_.size());
+
+    if (jacobians == NULL || jacobians[0] == NULL) {
+#ifdef EIGEN_VECTORIZE_AVX
+      Eigen::Map<Eigen::ArrayXd> r(residuals, num_samples);
+      Model::EvaluateBatch(p, x_, r);
+      r = y_ - r;
+#else
+      for (int i = 0; i < num_samples; ++i)
+        residuals[i] = y_[i] - Model::Evaluate(p, x_[i]);
+#endif
+      return true;
+    }
+
+    JetT p_jet[N];
+    for (int k = 0; k < N; ++k)
+      p_jet[k] = JetT(p[k], k);
+
+    double* jacobian = jacobians[0]; // row-major, num_samples x N
+    for (int i = 0; i < num_samples; ++i) {
+      const JetT f = Model::Evaluate(p_jet, x_[i]);
+      residuals[i] = y_[i] - f.a;
+      for (int k = 0; k < N; ++k)
+        jacobian[i*N + k] = -f.v[k];
+    }
+    return true;
+  }
+
+private:
+  Eigen::ArrayXd x_;
+  Eigen::ArrayXd y_;
+};
+
+
+struct CurveFitResult {
+  std::string model;
+  std::vector<double> parameters;
+  ceres::Solver::Summary summary;
+};
+
+// robust: one residual block per sample with a CauchyLoss (as main.cpp does), otherwise one batched block with the squared loss.
+template <typename Model>
+CurveFitResult fitModel(const double* _data, int _num_samples, bool _robust, const ceres::Solver::Options& _options, 
+                        const double* _initial_parameters = nullptr)
+{
+  std::array<double, Model::kNumParameters> p;
+  if (_initial_parameters != nullptr)
+    std::copy(_initial_parameters, _initial_parameters + Model::kNumParameters, p.begin());
+  else
+    Model::InitialGuess(p.data());
+
+  ceres::Problem problem;
+  if (_robust) {
+    for (int i = 0; i < _num_samples; ++i)
+      problem.AddResidualBlock(ModelResidual<Model>::Create(_data[2*i], _data[2*i + 1]), new ceres::CauchyLoss(1), p.data());
+  }
+  else {
+    problem.AddResidualBlock(new BatchedModelCostFunction<Model>(_data, _num_samples), NULL, p.data());
+  }
+
+  CurveFitResult result;
+  result.model = Model::Name();
+  ceres::Solve(_options, &problem, &result.summary);
+  result.parameters.assign(p.begin(), p.end());
+  return result;
+} // fitModel
+
+
+// Runtime selection of a model by its name, e.g., --model=gaussian.
+class CurveModelRegistry {
+public:
+  typedef std::function<CurveFitResult(const double*, int, bool, const ceres::Solver::Options&, const double*)> FitFunction;
+
+  struct Entry {
+    int num_parameters;
+    std::function<void(double*)> initial_guess;
+    FitFunction fit;
+  };
+
+public:
+  static CurveModelRegistry& Instance() {
+    static CurveModelRegistry registry;
+    return registry;
+  }
+
+  template <typename Model>
+  void Register() {
+    entries_[Model::Name()] = Entry {Model::kNumParameters, &Model::InitialGuess, &fitModel<Model>};
+  }
+
+  const Entry* Find(const std::string& _name) const {
+    auto found = entries_.find(_name);
+    return (found == entries_.end()) ? nullptr : &found->second;
+  }
+
+  std::vector<std::string> Names() const {
+    std::vector<std::string> names;
+    for (auto& _entry: entries_)
+      names.push_back(_entry.first);
+    return names;
+  }
+
+private:
+  CurveModelRegistry() {
+    Register<ExponentialModel>();
+    Register<PolynomialModel<1>>();
+    Register<PolynomialModel<2>>();
+    Register<PolynomialModel<3>>();
+    Register<GaussianModel>();
+    Register<SumOfExponentialsModel<2>>();
+    Register<LogisticModel>();
+  }
+
+  std::map<std::string, Entry> entries_;
+};
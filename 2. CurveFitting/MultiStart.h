@@ -0,0 +1,225 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "ceres/ceres.h"
+
+#include "Models.h"
+
+// Multi-start global initialization: a single start (e.g., m_init = c_init = 1.0) on noisy or multi-modal data may end in a poor
+// local minimum or cost many extra iterations. Instead,
+//  1. K starts are sampled in a box around the initial guess of the model, with a (randomly shifted) Halton sequence,
+//  2. short solves run concurrently on the threads of a persistent WorkerPool (created once, reused by every fit), and a start whose cost is still far above the best finished one
+//     after a few iterations is cancelled (IterationCallback returning SOLVER_ABORT),
+//  3. the best start is refined with the full solver options.
+struct MultiStartOptions {
+  int num_starts {16};
+  int short_max_iterations {10};
+  double box_half_width {2.0};        // the starts are sampled in initial_guess +- box_half_width
+  double abort_cost_ratio {2.0};      // a start is cancelled if its cost > ratio * the best final cost so far
+  int min_iterations_before_abort {3};
+  unsigned int seed {0};              // of the random shift of the Halton sequence
+};
+
+struct MultiStartResult {
+  CurveFitResult refined;
+  int best_start {-1};
+  double best_short_cost {std::numeric_limits<double>::infinity()};
+  int num_cancelled {0};
+  double time_in_seconds {0.0};
+};
+
+// A fixed set of threads kept across the fits, so that a multi-start fit does not pay for the thread creation each time.
+class WorkerPool {
+public:
+  explicit WorkerPool(int _num_threads); // including the calling thread
+  ~WorkerPool();
+
+  // runs _task on every thread of the pool (the calling one included), and returns once all of them are done
+  void runOnAll(const std::function<void()>& _task);
+
+  int num_threads() const { return static_cast<int>(workers_.size()) + 1; }
+
+private:
+  void workerLoop();
+
+private:
+  std::mutex mutex_;
+  std::condition_variable task_ready_;
+  std::condition_variable task_done_;
+  const std::function<void()>* task_ {nullptr};
+  unsigned long generation_ {0};
+  int num_running_ {0};
+  bool stop_ {false};
+  std::vector<std::thread> workers_;
+};
+
+inline WorkerPool::WorkerPool(int _num_threads) {
+  for (int t = 1; t < _num_threads; ++t)
+    workers_.emplace_back(&WorkerPool::workerLoop, this);
+} // WorkerPool
+
+inline WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  task_ready_.notify_all();
+  for (auto& _worker: workers_)
+    _worker.join();
+} // ~WorkerPool
+
+inline void WorkerPool::runOnAll(const std::function<void()>& _task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &_task;
+    num_running_ = static_cast<int>(workers_.size());
+    generation_++;
+  }
+  task_ready_.notify_all();
+  _task();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  task_done_.wait(lock, [this] { return num_running_ == 0; });
+  task_ = nullptr;
+} // runOnAll
+
+inline void WorkerPool::workerLoop() {
+  unsigned long seen_generation = 0;
+  while (true) {
+    const std::function<void()>* task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_ready_.wait(lock, [&] { return stop_ || generation_ != seen_generation; });
+      if (stop_)
+        return;
+      seen_generation = generation_;
+      task = task_;
+    }
+
+    (*task)();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      num_running_--;
+    }
+    task_done_.notify_one();
+  }
+} // workerLoop
+
+// Cancels a start that loses against the best finished one.
+struct CancelLosingStartCallback : public ceres::IterationCallback 
+{
+  CancelLosingStartCallback(const std::atomic<double>& best_cost, double ratio, int min_iterations) 
+  : best_cost(best_cost), ratio(ratio), min_iterations(min_iterations) {}
+  virtual ~CancelLosingStartCallback() {}
+
+  ceres::CallbackReturnType operator()(const ceres::IterationSummary& summary) final {
+    if (summary.iteration >= min_iterations && summary.cost > ratio * best_cost.load())
+      return ceres::SOLVER_ABORT;
+    return ceres::SOLVER_CONTINUE;
+  }
+
+  const std::atomic<double>& best_cost;
+  const double ratio;
+  const int min_iterations;
+};
+
+// the i-th element of the Halton sequence in base b, in [0, 1)
+inline double halton(int i, int b) {
+  double f = 1.0, r = 0.0;
+  for (int n = i + 1; n > 0; n /= b) {
+    f /= b;
+    r += f * (n % b);
+  }
+  return r;
+}
+
+// the starting points, one per row (Halton in the first dimensions' prime bases, shifted modulo 1 by a random vector)
+inline std::vector<std::vector<double>> sampleStarts(const double* _center, int _num_parameters, const MultiStartOptions& _options) {
+  static const int kPrimes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+  CHECK_LE(_num_parameters, static_cast<int>(sizeof(kPrimes) / sizeof(kPrimes[0])));
+
+  std::mt19937 random(_options.seed);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::vector<double> shift(_num_parameters);
+  for (auto& _s: shift)
+    _s = uniform(random);
+
+  std::vector<std::vector<double>> starts(_options.num_starts, std::vector<double>(_num_parameters));
+  for (int i = 0; i < _options.num_starts; ++i) {
+    for (int d = 0; d < _num_parameters; ++d) {
+      double u = halton(i, kPrimes[d]) + shift[d];
+      u -= std::floor(u);
+      starts[i][d] = _center[d] + _options.box_half_width * (2.0 * u - 1.0);
+    }
+  }
+  return starts;
+}
+
+inline MultiStartResult multiStartFit(const CurveModelRegistry::Entry& _model, const double* _data, int _num_samples, bool _robust,
+                                      const ceres::Solver::Options& _solver_options, const MultiStartOptions& _options, 
+                                      WorkerPool& _pool)
+{
+  const auto start_time = std::chrono::steady_clock::now();
+  MultiStartResult result;
+
+  std::vector<double> center(_model.num_parameters);
+  _model.initial_guess(center.data());
+  const auto starts = sampleStarts(center.data(), _model.num_parameters, _options);
+
+  std::vector<CurveFitResult> short_results(starts.size());
+  std::atomic<double> best_cost {std::numeric_limits<double>::infinity()};
+  std::atomic<int> next_start {0};
+  std::atomic<int> num_cancelled {0};
+
+  const std::function<void()> worker = [&]() {
+    CancelLosingStartCallback cancel(best_cost, _options.abort_cost_ratio, _options.min_iterations_before_abort);
+    ceres::Solver::Options options = _solver_options;
+    options.max_num_iterations = _options.short_max_iterations;
+    options.minimizer_progress_to_stdout = false;
+    options.num_threads = 1; // the starts are the parallelism
+    options.callbacks.push_back(&cancel);
+
+    for (int i = next_start++; i < static_cast<int>(starts.size()); i = next_start++) {
+      short_results[i] = _model.fit(_data, _num_samples, _robust, options, starts[i].data());
+      const ceres::Solver::Summary& summary = short_results[i].summary;
+      if (summary.termination_type == ceres::USER_FAILURE)
+        num_cancelled++;
+      if (!summary.IsSolutionUsable())
+        continue;
+
+      // atomic min of the best final cost
+      double best = best_cost.load();
+      while (summary.final_cost < best && !best_cost.compare_exchange_weak(best, summary.final_cost)) {}
+    }
+  };
+
+  _pool.runOnAll(worker); // a thread left without a start returns at once
+
+  for (int i = 0; i < static_cast<int>(short_results.size()); ++i) {
+    const ceres::Solver::Summary& summary = short_results[i].summary;
+    if (summary.IsSolutionUsable() && summary.final_cost < result.best_short_cost) {
+      result.best_short_cost = summary.final_cost;
+      result.best_start = i;
+    }
+  }
+  result.num_cancelled = num_cancelled;
+
+  // refine the winner with the full options (from the initial guess if, unexpectedly, every start failed)
+  const double* refine_from = (result.best_start >= 0) ? short_results[result.best_start].parameters.data() : center.data();
+  result.refined = _model.fit(_data, _num_samples, _robust, _solver_options, refine_from);
+
+  result.time_in_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+  return result;
+}
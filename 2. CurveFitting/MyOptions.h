@@ -1,3 +1,5 @@
+#include "gflags/gflags.h"
+
 #include "ceres/ceres.h"
 #include "ceres/loss_function.h"
 
@@ -9,6 +11,33 @@ using std::endl;
 using std::string;
 // using ceres::internal::StringPrintf;
 
+DEFINE_string(model, "",
+              "Fit a model of the library in Models.h (e.g., exponential, poly2, gaussian, sumexp2, logistic, or all) "
+              "instead of the hard-coded exponential residual.");
+
+DEFINE_int32(num_starts, 0,
+             "If positive, fit --model (exponential by default) from this many starts in parallel, see MultiStart.h.");
+
+DEFINE_int32(multistart_trials, 10,
+             "With --num_starts, the number of trials (each with a different random shift of the starts, and the single start "
+             "of the model's initial guess as the baseline) over which the time-to-solution and the success rate are reported.");
+
+DEFINE_double(minibatch_initial_fraction, 0.0,
+              "If positive, fit --model (exponential by default) with a warm phase on random subsets of the samples, starting "
+              "with this fraction of them (see MiniBatch.h), and compare it with the full-batch fit.");
+
+DEFINE_double(minibatch_growth, 3.0,
+              "Growth of the subset fraction from one mini-batch phase to the next.");
+
+DEFINE_int32(minibatch_phase_iterations, 5,
+             "Maximum number of iterations of each mini-batch phase.");
+
+DEFINE_int32(synthetic_samples, 0,
+             "If positive, fit a synthetic dataset of this many samples (of the same model as data.h) instead of data.h.");
+
+DEFINE_bool(robust, true,
+            "With --model, one residual block per sample with a CauchyLoss, otherwise one batched block with the squared loss.");
+
 // see here for details 
 //  http://ceres-solver.org/nnls_solving.html?highlight=options#solver-options
 void setSolverOptions(ceres::Solver::Options& _options)
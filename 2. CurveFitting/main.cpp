@@ -7,6 +7,9 @@
 
 #include "Residuals.h"
 #include "MyOptions.h"
+#include "Models.h"
+#include "MultiStart.h"
+#include "MiniBatch.h"
 
 #include "data.h"
 
@@ -15,12 +18,145 @@ int main(int argc, char** argv)
   //
   std::cout << "\nUsing Ceres veresion: " << CERES_VERSION_STRING << std::endl;
   google::InitGoogleLogging(argv[0]);
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
 
 
   // load data (in data.h)
   std::cout << "The number of input data measurements: " << kNumObservations << std::endl;
 
 
+  // mini-batch warm phase vs. the full batch, see MiniBatch.h
+  if (FLAGS_minibatch_initial_fraction > 0.0) {
+    ceres::Solver::Options options;
+    setSolverOptions(options);
+    options.minimizer_progress_to_stdout = false;
+
+    const std::string name = FLAGS_model.empty() ? "exponential" : FLAGS_model;
+    auto model = CurveModelRegistry::Instance().Find(name);
+    if (model == nullptr) {
+      std::cerr << "ERROR: unknown model " << name << "\n";
+      return 1;
+    }
+
+    std::vector<double> samples(data, data + 2 * kNumObservations);
+    if (FLAGS_synthetic_samples > 0)
+      samples = generateExponentialData(FLAGS_synthetic_samples);
+    const int num_samples = static_cast<int>(samples.size() / 2);
+
+    const auto full_start = std::chrono::steady_clock::now();
+    CurveFitResult full = model->fit(samples.data(), num_samples, FLAGS_robust, options, nullptr);
+    const double full_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - full_start).count();
+
+    MiniBatchOptions minibatch_options;
+    minibatch_options.initial_fraction = FLAGS_minibatch_initial_fraction;
+    minibatch_options.growth = FLAGS_minibatch_growth;
+    minibatch_options.phase_max_iterations = FLAGS_minibatch_phase_iterations;
+    MiniBatchResult minibatch = miniBatchFit(*model, samples.data(), num_samples, FLAGS_robust, options, minibatch_options);
+    double warm_time = 0.0;
+    for (size_t i = 0; i < minibatch.phases.size(); ++i) {
+      const MiniBatchPhaseStats& phase = minibatch.phases[i];
+      std::cout << "  " << (i + 1 < minibatch.phases.size() ? "phase" : "final phase") << " on " << phase.batch_size << " samples: " 
+                << phase.num_iterations << " iterations, " << phase.time_in_seconds << " sec\n";
+      if (i + 1 < minibatch.phases.size())
+        warm_time += phase.time_in_seconds;
+    }
+
+    // the time of both to reach the same cost, the worse of the two final costs
+    const double common_cost = std::max(full.summary.final_cost, minibatch.full_fit.summary.final_cost) * (1.0 + 1e-6);
+    std::cout << name << " on " << num_samples << " samples\n"
+              << "  full batch : final cost " << full.summary.final_cost << ", " << full.summary.iterations.size() 
+              << " iterations, " << full_time << " sec\n"
+              << "  mini-batch : final cost " << minibatch.full_fit.summary.final_cost << ", " << minibatch.full_fit.summary.iterations.size() 
+              << " full-dataset iterations, " << minibatch.time_in_seconds << " sec in total\n"
+              << "  to reach the cost " << common_cost << ": full batch " << timeToCost(full.summary, common_cost) 
+              << " sec, mini-batch " << warm_time + timeToCost(minibatch.full_fit.summary, common_cost) << " sec (the warm phases included)\n";
+    return 0;
+  }
+
+  // multi-start vs. the single start of the model's initial guess (e.g., m = c = 1), see MultiStart.h
+  if (FLAGS_num_starts > 0) {
+    CHECK_GT(FLAGS_multistart_trials, 0);
+    ceres::Solver::Options options;
+    setSolverOptions(options);
+    options.minimizer_progress_to_stdout = false;
+
+    const std::string name = FLAGS_model.empty() ? "exponential" : FLAGS_model;
+    auto model = CurveModelRegistry::Instance().Find(name);
+    if (model == nullptr) {
+      std::cerr << "ERROR: unknown model " << name << "\n";
+      return 1;
+    }
+
+    MultiStartOptions multistart_options;
+    multistart_options.num_starts = FLAGS_num_starts;
+    WorkerPool pool(std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()), FLAGS_num_starts)));
+
+    std::vector<double> single_costs, multi_costs;
+    double single_time = 0.0, multi_time = 0.0;
+    int num_cancelled = 0;
+    for (int trial = 0; trial < FLAGS_multistart_trials; ++trial) {
+      // the baseline: the usual single start, the initial guess of the model
+      std::vector<double> start(model->num_parameters);
+      model->initial_guess(start.data());
+
+      const auto single_begin = std::chrono::steady_clock::now();
+      CurveFitResult single = model->fit(data, kNumObservations, FLAGS_robust, options, start.data());
+      single_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - single_begin).count();
+      single_costs.push_back(single.summary.IsSolutionUsable() ? single.summary.final_cost : std::numeric_limits<double>::infinity());
+
+      multistart_options.seed = trial;
+      MultiStartResult multi = multiStartFit(*model, data, kNumObservations, FLAGS_robust, options, multistart_options, pool);
+      multi_time += multi.time_in_seconds;
+      multi_costs.push_back(multi.refined.summary.IsSolutionUsable() ? multi.refined.summary.final_cost : std::numeric_limits<double>::infinity());
+      num_cancelled += multi.num_cancelled;
+    }
+
+    // a trial succeeds if it reaches the best cost found by any trial (up to a relative tolerance)
+    const double best_cost = std::min(*std::min_element(single_costs.begin(), single_costs.end()),
+                                      *std::min_element(multi_costs.begin(), multi_costs.end()));
+    auto successRate = [&](const std::vector<double>& _costs) {
+      int num_success = 0;
+      for (auto& _cost: _costs)
+        num_success += (_cost <= best_cost * (1.0 + 1e-6) + 1e-12) ? 1 : 0;
+      return static_cast<double>(num_success) / _costs.size();
+    };
+
+    std::cout << name << " - best cost: " << best_cost << "\n"
+              << "  initial guess: success rate " << successRate(single_costs) 
+              << ", mean time-to-solution " << 1e3 * single_time / FLAGS_multistart_trials << " ms\n"
+              << "  " << FLAGS_num_starts << " starts    : success rate " << successRate(multi_costs) 
+              << ", mean time-to-solution " << 1e3 * multi_time / FLAGS_multistart_trials << " ms"
+              << " (" << static_cast<double>(num_cancelled) / FLAGS_multistart_trials << " starts cancelled per trial)\n";
+    return 0;
+  }
+
+  // fit the model(s) selected at runtime, see Models.h
+  if (!FLAGS_model.empty()) {
+    ceres::Solver::Options options;
+    setSolverOptions(options);
+    options.minimizer_progress_to_stdout = false;
+
+    const auto& registry = CurveModelRegistry::Instance();
+    std::vector<std::string> names {FLAGS_model};
+    if (FLAGS_model == "all")
+      names = registry.Names();
+
+    for (auto& _name: names) {
+      auto model = registry.Find(_name);
+      if (model == nullptr) {
+        std::cerr << "ERROR: unknown model " << _name << "\n";
+        return 1;
+      }
+      CurveFitResult result = model->fit(data, kNumObservations, FLAGS_robust, options, nullptr);
+      std::cout << result.model << ": " << result.summary.BriefReport() << "\n  parameters:";
+      for (auto& _p: result.parameters)
+        std::cout << " " << _p;
+      std::cout << "\n";
+    }
+    return 0;
+  }
+
+
   // init problem 
   double m_init = 1.0; 
   double c_init = 1.0;
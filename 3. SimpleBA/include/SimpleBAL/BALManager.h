@@ -1,10 +1,19 @@
 #pragma once
 
+#include <algorithm>
+#include <climits>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <new>
+#include <random>
 #include <string>
+#include <vector>
+
+#include "Eigen/Core"
+#include "Eigen/Geometry"
 
 #include "ceres/ceres.h"
 #include "ceres/rotation.h"
@@ -18,36 +27,85 @@ public:
 
   const double* observations() const { return observations_; }
   int num_observations() const { return num_observations_; }
+  int num_cameras() const { return num_cameras_; }
+  int num_points() const { return num_points_; }
+  int num_parameters() const { return num_parameters_; }
+  const double* parameters() const { return parameters_; } // cameras, then points
+  int camera_index(int i) const { return camera_index_[i]; }
+  int point_index(int i) const { return point_index_[i]; }
 
   double* mutable_cameras() { return parameters_; } // // return the pointer at the "start position" of the camera parameters 
   double* mutable_points() { return parameters_ + 9*num_cameras_; } // return the pointer at the "start position" of the landmakrs 
   double* mutable_camera_for_observation(int i);
   double* mutable_point_for_observation(int i);
 
-  bool loadFile(const char* filename);
+  // false (with the reason in _error, if given) if the file is missing or malformed, and the manager is left empty
+  bool loadFile(const char* filename, std::string* _error = nullptr);
+
+  // A synthetic scene in place of a file: the cameras on a ring looking at a cloud of points, each point observed by
+  // _observations_per_point cameras through the Snavely model (with a pixel of noise), and the parameters perturbed from the truth.
+  // The scene is centered at _offset with a radius of _scale, to mimic the arbitrary centroid/scale of the raw BAL datasets.
+  void generateSynthetic(int _num_cameras, int _num_points, int _observations_per_point, 
+                         double _offset, double _scale, unsigned int _seed);
   void writeResultFile(const std::string& filename);
   void writeResultFile(void);
   void writeResultFile(int _iter_counter);
 
+  // Conditioning of the raw BAL data (scene centroid/scale are arbitrary, focal lengths are in the hundreds while rotations are around 1).
+  //  - scene   : X' = s * (X - median), and each camera center c is mapped the same way (thus t' = -R c'), which keeps every reprojection unchanged.
+  //  - cameras : (optional) the focal lengths and the observations are divided by the power of two nearest to the median focal length,
+  //              so the reprojection errors are scaled by a constant and the exact values are recovered when multiplying it back.
+  void normalize(bool _normalize_cameras);
+  void denormalize(void); // map the parameters (and the observations) back to the input frame
+  bool isNormalized() const { return normalized_; }
+  const double* sceneCenter() const { return scene_center_; }
+  double sceneScale() const { return scene_scale_; }             // s, a length of 1 in the input frame is s in the normalized frame
+  double observationScale() const { return observation_scale_; } // a pixel in the normalized frame is this many pixels in the input frame
+
+  // Bytes held by the loader arrays (see MemoryReport.h for the whole footprint).
+  struct MemoryUsage {
+    size_t indices;       // camera and point index of each observation
+    size_t observations;  // x, y of each observation
+    size_t parameters;    // cameras, then points
+    size_t total() const { return indices + observations + parameters; }
+  };
+  MemoryUsage memoryUsage() const;
+
+  // Low-memory mode: once the residual blocks are built, the problem keeps the pointers to the parameter blocks, and each cost function
+  // its own copy of the observation, thus the index and observation arrays (the parsed text) can be freed before the solve.
+  // Afterwards, only the parameters are available (the per-observation accessors must not be called).
+  void releaseObservations(void);
+  bool hasObservations() const { return observations_ != nullptr; }
+
+  void cameraToCenter(const double* _camera, double* _center) const; // c = -R^T t
+  void centerToCamera(const double* _center, double* _camera) const; // t = -R c, using the rotation of _camera
+
+private:
+  void originalPoint(int _point_index, double* _point) const; // the point in the input frame, regardless of the normalization
+  void writePoints(const std::string& _filename) const;
+
 private:
   template <typename T>
-  void FscanfOrDie(FILE* fptr, const char* format, T* value) {
-    int num_scanned = fscanf(fptr, format, value);
-    if (num_scanned != 1) {
-      LOG(FATAL) << "Invalid UW data file.";
-    }
+  static bool Fscanf(FILE* fptr, const char* format, T* value) {
+    return fscanf(fptr, format, value) == 1;
   }
+  void clear(void);
 
 private:
-  int num_cameras_;
-  int num_points_;
-  int num_observations_;
-  int num_parameters_;
+  int num_cameras_ {0};
+  int num_points_ {0};
+  int num_observations_ {0};
+  int num_parameters_ {0};
+
+  int* point_index_ {nullptr};
+  int* camera_index_ {nullptr};
+  double* observations_ {nullptr};
+  double* parameters_ {nullptr};
 
-  int* point_index_;
-  int* camera_index_;
-  double* observations_;
-  double* parameters_;
+  bool normalized_ {false};
+  double scene_center_[3] {0.0, 0.0, 0.0};
+  double scene_scale_ {1.0};
+  double observation_scale_ {1.0};
 
 public:
   std::string fileName;
@@ -57,45 +115,205 @@ public:
 
 
 double* simplebal::BALManager::mutable_camera_for_observation(int i) {
+  DCHECK(camera_index_ != nullptr) << "the observations were released";
   return mutable_cameras() + 9*camera_index_[i];
 } // mutable_camera_for_observation
 
 double* simplebal::BALManager::mutable_point_for_observation(int i) {
+  DCHECK(point_index_ != nullptr) << "the observations were released";
   return mutable_points() + 3*point_index_[i];
 } // mutable_point_for_observation
 
-bool simplebal::BALManager::loadFile(const char* filename) {
+bool simplebal::BALManager::loadFile(const char* filename, std::string* _error) {
+  clear();
   FILE* fptr = fopen(filename, "r");
   if (fptr == NULL) {
+    if (_error != nullptr)
+      *_error = "unable to open " + std::string(filename);
     return false;
   };
 
-  FscanfOrDie(fptr, "%d", &num_cameras_);
-  FscanfOrDie(fptr, "%d", &num_points_);
-  FscanfOrDie(fptr, "%d", &num_observations_);
+  // a malformed file must not abort the process (e.g., a solve server), so it leaves an empty manager instead
+  auto invalid = [&](const std::string& _reason) {
+    fclose(fptr);
+    clear();
+    if (_error != nullptr)
+      *_error = "invalid BAL file " + std::string(filename) + " (" + _reason + ")";
+    return false;
+  };
 
-  point_index_ = new int[num_observations_];
-  camera_index_ = new int[num_observations_];
-  observations_ = new double[2 * num_observations_];
+  const int64_t file_size = (fseeko(fptr, 0, SEEK_END) == 0) ? static_cast<int64_t>(ftello(fptr)) : -1;
+  if (file_size < 0 || fseeko(fptr, 0, SEEK_SET) != 0)
+    return invalid("unable to get the file size");
 
-  num_parameters_ = 9*num_cameras_ + 3*num_points_;
-  parameters_ = new double[num_parameters_];
+  if (!Fscanf(fptr, "%d", &num_cameras_) || !Fscanf(fptr, "%d", &num_points_) || !Fscanf(fptr, "%d", &num_observations_))
+    return invalid("incomplete header");
+  if (num_cameras_ <= 0 || num_points_ <= 0 || num_observations_ <= 0)
+    return invalid("non-positive sizes in the header");
+
+  // the sizes come from the file, so they are checked (in 64 bits) before anything is allocated: the arrays must be
+  // indexable by an int, and the file must be large enough to hold them (at least "0 0 0 0\n" per observation and "0\n" per parameter)
+  const int64_t num_parameters = 9 * static_cast<int64_t>(num_cameras_) + 3 * static_cast<int64_t>(num_points_);
+  if (2 * static_cast<int64_t>(num_observations_) > INT_MAX || num_parameters > INT_MAX)
+    return invalid("sizes in the header too large");
+  if (8 * static_cast<int64_t>(num_observations_) + 2 * num_parameters > file_size)
+    return invalid("sizes in the header larger than the file");
+
+  num_parameters_ = static_cast<int>(num_parameters);
+  try {
+    point_index_ = new int[num_observations_];
+    camera_index_ = new int[num_observations_];
+    observations_ = new double[2 * num_observations_];
+    parameters_ = new double[num_parameters_];
+  }
+  catch (const std::bad_alloc&) {
+    return invalid("out of memory");
+  }
 
   for (int i = 0; i < num_observations_; ++i) {
-    FscanfOrDie(fptr, "%d", camera_index_ + i);
-    FscanfOrDie(fptr, "%d", point_index_ + i);
-    for (int j = 0; j < 2; ++j) {
-      FscanfOrDie(fptr, "%lf", observations_ + 2 * i + j);
-    }
+    if (!Fscanf(fptr, "%d", camera_index_ + i) || !Fscanf(fptr, "%d", point_index_ + i) 
+        || !Fscanf(fptr, "%lf", observations_ + 2 * i + 0) || !Fscanf(fptr, "%lf", observations_ + 2 * i + 1))
+      return invalid("truncated observation " + std::to_string(i));
+    if (camera_index_[i] < 0 || camera_index_[i] >= num_cameras_ || point_index_[i] < 0 || point_index_[i] >= num_points_)
+      return invalid("index out of range in observation " + std::to_string(i));
   }
 
   for (int i = 0; i < num_parameters_; ++i) {
-    FscanfOrDie(fptr, "%lf", parameters_ + i);
+    if (!Fscanf(fptr, "%lf", parameters_ + i))
+      return invalid("truncated parameters");
   }
 
+  fclose(fptr);
   return true;
 } // loadFile
 
+simplebal::BALManager::MemoryUsage simplebal::BALManager::memoryUsage() const {
+  MemoryUsage usage;
+  usage.indices = ((camera_index_ != nullptr) ? sizeof(int) * num_observations_ : 0)
+                + ((point_index_ != nullptr) ? sizeof(int) * num_observations_ : 0);
+  usage.observations = (observations_ != nullptr) ? sizeof(double) * 2 * num_observations_ : 0;
+  usage.parameters = (parameters_ != nullptr) ? sizeof(double) * num_parameters_ : 0;
+  return usage;
+} // memoryUsage
+
+void simplebal::BALManager::releaseObservations(void) {
+  delete[] point_index_;
+  delete[] camera_index_;
+  delete[] observations_;
+  point_index_ = nullptr;
+  camera_index_ = nullptr;
+  observations_ = nullptr;
+} // releaseObservations
+
+void simplebal::BALManager::clear(void) {
+  releaseObservations();
+  delete[] parameters_;
+  parameters_ = nullptr;
+  num_cameras_ = num_points_ = num_observations_ = num_parameters_ = 0;
+} // clear
+
+void simplebal::BALManager::generateSynthetic(int _num_cameras, int _num_points, int _observations_per_point, 
+                                              double _offset, double _scale, unsigned int _seed) {
+  CHECK_GT(_num_cameras, 0);
+  CHECK_GT(_num_points, 0);
+  releaseObservations();
+  delete[] parameters_;
+
+  _observations_per_point = std::max(1, std::min(_observations_per_point, _num_cameras));
+  num_cameras_ = _num_cameras;
+  num_points_ = _num_points;
+  num_observations_ = _num_points * _observations_per_point;
+  num_parameters_ = 9*num_cameras_ + 3*num_points_;
+  point_index_ = new int[num_observations_];
+  camera_index_ = new int[num_observations_];
+  observations_ = new double[2 * num_observations_];
+  parameters_ = new double[num_parameters_];
+
+  std::mt19937 random(_seed);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  const Eigen::Vector3d center(_offset, _offset, _offset);
+
+  // the true cameras: on a ring of radius 4 * _scale, looking at the center (the Bundler cameras look down their -z axis)
+  double* cameras = mutable_cameras();
+  for (int i = 0; i < num_cameras_; ++i) {
+    const double angle = 2.0 * M_PI * i / num_cameras_;
+    const Eigen::Vector3d position = center + 4.0 * _scale * Eigen::Vector3d(std::cos(angle), std::sin(angle), 0.25 * uniform(random));
+    const Eigen::Vector3d backward = (position - center).normalized();
+    const Eigen::Vector3d right = Eigen::Vector3d::UnitZ().cross(backward).normalized();
+    Eigen::Matrix3d rotation; // rows: the camera axes in the world frame
+    rotation.row(0) = right;
+    rotation.row(1) = backward.cross(right);
+    rotation.row(2) = backward;
+    const Eigen::AngleAxisd angle_axis(rotation);
+
+    double* camera = cameras + 9*i;
+    Eigen::Map<Eigen::Vector3d> camera_rotation(camera);
+    Eigen::Map<Eigen::Vector3d> camera_translation(camera + 3);
+    camera_rotation = angle_axis.angle() * angle_axis.axis();
+    camera_translation = -(rotation * position);
+    camera[6] = 500.0;
+    camera[7] = 0.0;
+    camera[8] = 0.0;
+  }
+
+  // the true points: uniformly in a ball of radius _scale
+  double* points = mutable_points();
+  for (int j = 0; j < num_points_; ++j) {
+    Eigen::Vector3d offset;
+    do {
+      offset = Eigen::Vector3d(uniform(random), uniform(random), uniform(random));
+    } while (offset.squaredNorm() > 1.0);
+    Eigen::Map<Eigen::Vector3d> point(points + 3*j);
+    point = center + _scale * offset;
+  }
+
+  // the observations, each point by distinct random cameras
+  std::vector<int> camera_order(num_cameras_);
+  for (int i = 0; i < num_cameras_; ++i)
+    camera_order[i] = i;
+  for (int j = 0, k = 0; j < num_points_; ++j) {
+    for (int n = 0; n < _observations_per_point; ++n, ++k) {
+      std::uniform_int_distribution<int> pick(n, num_cameras_ - 1);
+      std::swap(camera_order[n], camera_order[pick(random)]);
+      camera_index_[k] = camera_order[n];
+      point_index_[k] = j;
+
+      const double* camera = cameras + 9*camera_order[n];
+      double p[3];
+      ceres::AngleAxisRotatePoint(camera, points + 3*j, p);
+      for (int d = 0; d < 3; ++d)
+        p[d] += camera[3 + d];
+      const double xp = -p[0] / p[2];
+      const double yp = -p[1] / p[2];
+      observations_[2*k + 0] = camera[6] * xp + normal(random);
+      observations_[2*k + 1] = camera[6] * yp + normal(random);
+    }
+  }
+
+  // the initial values: the points and the camera centers moved by 2% of the scene radius, the rotations by ~0.5 degree, 
+  // and the focal lengths by 2%
+  for (int j = 0; j < num_points_; ++j)
+    for (int d = 0; d < 3; ++d)
+      points[3*j + d] += 0.02 * _scale * normal(random);
+  for (int i = 0; i < num_cameras_; ++i) {
+    double* camera = cameras + 9*i;
+    double camera_center[3];
+    cameraToCenter(camera, camera_center);
+    for (int d = 0; d < 3; ++d) {
+      camera[d] += 0.01 * normal(random);
+      camera_center[d] += 0.02 * _scale * normal(random);
+    }
+    centerToCamera(camera_center, camera);
+    camera[6] *= 1.0 + 0.02 * normal(random);
+  }
+
+  normalized_ = false;
+  scene_center_[0] = scene_center_[1] = scene_center_[2] = 0.0;
+  scene_scale_ = 1.0;
+  observation_scale_ = 1.0;
+} // generateSynthetic
+
 simplebal::BALManager::~BALManager() {
     delete[] point_index_;
     delete[] camera_index_;
@@ -122,17 +340,7 @@ void simplebal::BALManager::writeResultFile(void) {
     fileNameTmp = fileName;
     
 	// write File
-	std::ofstream writeFile(fileNameTmp.data());
-	if( writeFile.is_open() ) {
-    for(int i=0; i<num_points_; i++) {
-      double x = *(mutable_points() + 3*i + 0);
-      double y = *(mutable_points() + 3*i + 1);
-      double z = *(mutable_points() + 3*i + 2);
-      // std::cout << x << " " << y << " " << z << std::endl;
-      writeFile << x << " " << y << " " << z << std::endl;
-    }
-		writeFile.close();
-	}
+  writePoints(fileNameTmp);
 } // writeResultFile
 
 void simplebal::BALManager::writeResultFile(int _iter_counter) {
@@ -141,15 +349,129 @@ void simplebal::BALManager::writeResultFile(int _iter_counter) {
     fileNameTmp = fileName;
     
 	// write File
-	std::ofstream writeFile(fileNameTmp + "-" + std::to_string(_iter_counter) + ".csv");
+  writePoints(fileNameTmp + "-" + std::to_string(_iter_counter) + ".csv");
+} // writeResultFile
+
+void simplebal::BALManager::writePoints(const std::string& _filename) const {
+	std::ofstream writeFile(_filename.data());
 	if( writeFile.is_open() ) {
     for(int i=0; i<num_points_; i++) {
-      double x = *(mutable_points() + 3*i + 0);
-      double y = *(mutable_points() + 3*i + 1);
-      double z = *(mutable_points() + 3*i + 2);
-      // std::cout << x << " " << y << " " << z << std::endl;
-      writeFile << x << " " << y << " " << z << std::endl;
+      double point[3];
+      originalPoint(i, point);
+      // std::cout << point[0] << " " << point[1] << " " << point[2] << std::endl;
+      writeFile << point[0] << " " << point[1] << " " << point[2] << std::endl;
     }
 		writeFile.close();
 	}
-} // writeResultFile
+} // writePoints
+
+void simplebal::BALManager::originalPoint(int _point_index, double* _point) const {
+  const double* point = parameters_ + 9*num_cameras_ + 3*_point_index;
+  for (int k = 0; k < 3; ++k)
+    _point[k] = point[k] / scene_scale_ + scene_center_[k];
+} // originalPoint
+
+void simplebal::BALManager::cameraToCenter(const double* _camera, double* _center) const {
+  // c = -R^T t, and R^T is the rotation by the negated angle-axis vector.
+  const double inverse_rotation[3] = {-_camera[0], -_camera[1], -_camera[2]};
+  ceres::AngleAxisRotatePoint(inverse_rotation, _camera + 3, _center);
+  for (int k = 0; k < 3; ++k)
+    _center[k] = -_center[k];
+} // cameraToCenter
+
+void simplebal::BALManager::centerToCamera(const double* _center, double* _camera) const {
+  // t = -R c
+  ceres::AngleAxisRotatePoint(_camera, _center, _camera + 3);
+  for (int k = 0; k < 3; ++k)
+    _camera[3 + k] = -_camera[3 + k];
+} // centerToCamera
+
+void simplebal::BALManager::normalize(bool _normalize_cameras) {
+  if (normalized_)
+    return;
+
+  double* points = mutable_points();
+  double* cameras = mutable_cameras();
+
+  if (num_points_ == 0 || num_cameras_ == 0)
+    return;
+
+  // the component-wise median is robust to the far-away points
+  std::vector<double> values(num_points_);
+  for (int k = 0; k < 3; ++k) {
+    for (int i = 0; i < num_points_; ++i)
+      values[i] = points[3*i + k];
+    std::nth_element(values.begin(), values.begin() + num_points_/2, values.end());
+    scene_center_[k] = values[num_points_/2];
+  }
+
+  // the median absolute deviation (L1) is mapped to 100, as in the ceres bundle_adjuster example
+  for (int i = 0; i < num_points_; ++i) {
+    values[i] = std::abs(points[3*i + 0] - scene_center_[0])
+              + std::abs(points[3*i + 1] - scene_center_[1])
+              + std::abs(points[3*i + 2] - scene_center_[2]);
+  }
+  std::nth_element(values.begin(), values.begin() + num_points_/2, values.end());
+  const double median_absolute_deviation = values[num_points_/2];
+  scene_scale_ = (median_absolute_deviation > 0.0) ? 100.0 / median_absolute_deviation : 1.0;
+
+  for (int i = 0; i < num_points_; ++i) {
+    for (int k = 0; k < 3; ++k)
+      points[3*i + k] = scene_scale_ * (points[3*i + k] - scene_center_[k]);
+  }
+
+  for (int i = 0; i < num_cameras_; ++i) {
+    double* camera = cameras + 9*i;
+    double center[3];
+    cameraToCenter(camera, center);
+    for (int k = 0; k < 3; ++k)
+      center[k] = scene_scale_ * (center[k] - scene_center_[k]);
+    centerToCamera(center, camera);
+  }
+
+  // divide by a power of two near the median focal length, so the division and the later multiplication are both exact
+  if (_normalize_cameras) {
+    std::vector<double> focals(num_cameras_);
+    for (int i = 0; i < num_cameras_; ++i)
+      focals[i] = std::abs(cameras[9*i + 6]);
+    std::nth_element(focals.begin(), focals.begin() + num_cameras_/2, focals.end());
+    const double median_focal = focals[num_cameras_/2];
+    observation_scale_ = (median_focal > 0.0) ? std::exp2(std::round(std::log2(median_focal))) : 1.0;
+
+    for (int i = 0; i < num_cameras_; ++i)
+      cameras[9*i + 6] /= observation_scale_;
+    for (int i = 0; observations_ != nullptr && i < 2*num_observations_; ++i)
+      observations_[i] /= observation_scale_;
+  }
+
+  normalized_ = true;
+} // normalize
+
+void simplebal::BALManager::denormalize(void) {
+  if (!normalized_)
+    return;
+
+  double* points = mutable_points();
+  double* cameras = mutable_cameras();
+
+  for (int i = 0; i < num_points_; ++i)
+    originalPoint(i, points + 3*i);
+
+  for (int i = 0; i < num_cameras_; ++i) {
+    double* camera = cameras + 9*i;
+    double center[3];
+    cameraToCenter(camera, center);
+    for (int k = 0; k < 3; ++k)
+      center[k] = center[k] / scene_scale_ + scene_center_[k];
+    centerToCamera(center, camera);
+    camera[6] *= observation_scale_;
+  }
+
+  for (int i = 0; observations_ != nullptr && i < 2*num_observations_; ++i)
+    observations_[i] *= observation_scale_;
+
+  scene_center_[0] = scene_center_[1] = scene_center_[2] = 0.0;
+  scene_scale_ = 1.0;
+  observation_scale_ = 1.0;
+  normalized_ = false;
+} // denormalize
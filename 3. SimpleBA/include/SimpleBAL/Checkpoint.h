@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ceres/ceres.h"
+
+#include "SimpleBAL/BALManager.h"
+
+namespace simplebal {
+
+// Binary checkpoint of the solver state (all the parameters, as they are in BALManager, i.e., in the normalized frame if normalized).
+//   char[8] "BALCKP1", int32 iteration, int32 num_parameters, double trust_region_radius,
+//   double scene_center[3], double scene_scale, double observation_scale, double parameters[num_parameters]
+struct CheckpointHeader {
+  int32_t iteration {0};
+  int32_t num_parameters {0};
+  double trust_region_radius {0.0};
+  double scene_center[3] {0.0, 0.0, 0.0};
+  double scene_scale {1.0};
+  double observation_scale {1.0};
+};
+
+// Loads a checkpoint into the parameters of _balManager. It fails if the checkpoint does not fit the loaded problem,
+// or was saved with a different normalization (so resume with the same --normalize flags).
+bool loadCheckpoint(const std::string& _filename, BALManager& _balManager, CheckpointHeader* _header);
+
+// Saves the state periodically (every _every_n iterations) during a solve. The callback only copies the parameters into
+// a buffer, and a background thread writes it to "<file>.tmp" then renames it to "<file>", so the solver is not blocked by the
+// disk and a preempted job never leaves a truncated checkpoint behind. If the writer is still busy, the newer state replaces
+// the pending one. Requires options.update_state_every_iteration = true.
+class CheckpointCallback : public ceres::IterationCallback 
+{
+public:
+  CheckpointCallback(BALManager& _balManager, const std::string& _filename, int _every_n, int _iteration_offset = 0);
+  virtual ~CheckpointCallback();
+
+  ceres::CallbackReturnType operator()(const ceres::IterationSummary& summary) final;
+
+  int num_written() const { return num_written_; }
+
+private:
+  void writerLoop();
+  bool writeAtomically(const CheckpointHeader& _header, const std::vector<double>& _parameters);
+
+private:
+  BALManager& balManager_;
+  const std::string filename_;
+  const int every_n_;
+  const int iteration_offset_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool has_pending_ {false};
+  bool stop_ {false};
+  CheckpointHeader pending_header_;
+  std::vector<double> pending_parameters_;
+  std::atomic<int> num_written_ {0};
+  std::thread writer_;
+};
+
+} // namespace simplebal
+
+
+bool simplebal::loadCheckpoint(const std::string& _filename, BALManager& _balManager, CheckpointHeader* _header) {
+  std::ifstream readFile(_filename.data(), std::ios::binary);
+  if (!readFile.is_open())
+    return false;
+
+  char magic[8];
+  CheckpointHeader header;
+  readFile.read(magic, sizeof(magic));
+  readFile.read(reinterpret_cast<char*>(&header.iteration), sizeof(header.iteration));
+  readFile.read(reinterpret_cast<char*>(&header.num_parameters), sizeof(header.num_parameters));
+  readFile.read(reinterpret_cast<char*>(&header.trust_region_radius), sizeof(header.trust_region_radius));
+  readFile.read(reinterpret_cast<char*>(header.scene_center), sizeof(header.scene_center));
+  readFile.read(reinterpret_cast<char*>(&header.scene_scale), sizeof(header.scene_scale));
+  readFile.read(reinterpret_cast<char*>(&header.observation_scale), sizeof(header.observation_scale));
+  if (!readFile.good() || std::string(magic, 7) != "BALCKP1") {
+    LOG(ERROR) << "Invalid checkpoint file: " << _filename;
+    return false;
+  }
+
+  if (header.num_parameters != _balManager.num_parameters()) {
+    LOG(ERROR) << "The checkpoint has " << header.num_parameters << " parameters, but the problem has " << _balManager.num_parameters();
+    return false;
+  }
+  // the normalization is deterministic for a given input, so the values must match exactly
+  const double* scene_center = _balManager.sceneCenter();
+  if (header.scene_scale != _balManager.sceneScale() || header.observation_scale != _balManager.observationScale()
+      || header.scene_center[0] != scene_center[0] || header.scene_center[1] != scene_center[1] || header.scene_center[2] != scene_center[2]) {
+    LOG(ERROR) << "The checkpoint was saved with a different normalization.";
+    return false;
+  }
+
+  readFile.read(reinterpret_cast<char*>(_balManager.mutable_cameras()), sizeof(double) * header.num_parameters);
+  if (!readFile.good()) {
+    LOG(ERROR) << "Truncated checkpoint file: " << _filename;
+    return false;
+  }
+
+  *_header = header;
+  return true;
+} // loadCheckpoint
+
+simplebal::CheckpointCallback::CheckpointCallback(BALManager& _balManager, const std::string& _filename, int _every_n, int _iteration_offset)
+: balManager_(_balManager),
+  filename_(_filename),
+  every_n_(std::max(1, _every_n)),
+  iteration_offset_(_iteration_offset),
+  pending_parameters_(_balManager.num_parameters())
+{
+  writer_ = std::thread(&CheckpointCallback::writerLoop, this);
+} // CheckpointCallback
+
+simplebal::CheckpointCallback::~CheckpointCallback() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true; // the pending checkpoint (if any) is still written before the thread ends
+  }
+  condition_.notify_one();
+  writer_.join();
+} // ~CheckpointCallback
+
+ceres::CallbackReturnType simplebal::CheckpointCallback::operator()(const ceres::IterationSummary& summary) {
+  if (summary.iteration == 0 || summary.iteration % every_n_ != 0)
+    return ceres::SOLVER_CONTINUE;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_header_.iteration = iteration_offset_ + summary.iteration;
+    pending_header_.num_parameters = balManager_.num_parameters();
+    pending_header_.trust_region_radius = summary.trust_region_radius;
+    std::copy(balManager_.sceneCenter(), balManager_.sceneCenter() + 3, pending_header_.scene_center);
+    pending_header_.scene_scale = balManager_.sceneScale();
+    pending_header_.observation_scale = balManager_.observationScale();
+    std::copy(balManager_.mutable_cameras(), balManager_.mutable_cameras() + balManager_.num_parameters(), pending_parameters_.begin());
+    has_pending_ = true;
+  }
+  condition_.notify_one();
+  return ceres::SOLVER_CONTINUE;
+} // operator()
+
+void simplebal::CheckpointCallback::writerLoop() {
+  CheckpointHeader header;
+  std::vector<double> parameters(pending_parameters_.size());
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this] { return has_pending_ || stop_; });
+      if (!has_pending_) // stopped, and nothing left to write
+        return;
+      header = pending_header_;
+      parameters.swap(pending_parameters_); // the callback keeps copying into the other buffer
+      has_pending_ = false;
+    }
+
+    if (writeAtomically(header, parameters)) {
+      cout << "     checkpoint saved at iteration " << header.iteration << endl;
+      num_written_++;
+    }
+    else {
+      LOG(ERROR) << "Unable to write the checkpoint " << filename_;
+    }
+  }
+} // writerLoop
+
+bool simplebal::CheckpointCallback::writeAtomically(const CheckpointHeader& _header, const std::vector<double>& _parameters) {
+  const std::string tmpFilename = filename_ + ".tmp";
+  {
+    std::ofstream writeFile(tmpFilename.data(), std::ios::binary | std::ios::trunc);
+    if (!writeFile.is_open())
+      return false;
+
+    const char magic[8] = "BALCKP1";
+    writeFile.write(magic, sizeof(magic));
+    writeFile.write(reinterpret_cast<const char*>(&_header.iteration), sizeof(_header.iteration));
+    writeFile.write(reinterpret_cast<const char*>(&_header.num_parameters), sizeof(_header.num_parameters));
+    writeFile.write(reinterpret_cast<const char*>(&_header.trust_region_radius), sizeof(_header.trust_region_radius));
+    writeFile.write(reinterpret_cast<const char*>(_header.scene_center), sizeof(_header.scene_center));
+    writeFile.write(reinterpret_cast<const char*>(&_header.scene_scale), sizeof(_header.scene_scale));
+    writeFile.write(reinterpret_cast<const char*>(&_header.observation_scale), sizeof(_header.observation_scale));
+    writeFile.write(reinterpret_cast<const char*>(_parameters.data()), sizeof(double) * _parameters.size());
+    writeFile.flush();
+    if (!writeFile.good())
+      return false;
+  }
+
+  // rename() replaces the previous checkpoint atomically (on the same filesystem)
+  return std::rename(tmpFilename.c_str(), filename_.c_str()) == 0;
+} // writeAtomically
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ceres/ceres.h"
+#include "ceres/covariance.h"
+#include "ceres/manifold.h"
+
+#include "SimpleBAL/BALManager.h"
+#include "SimpleBAL/OutlierPruner.h"
+#include "SimpleBAL/Residual.h"
+
+namespace simplebal {
+
+// Post-solve marginal covariances of every camera (9x9) and of a user-selected subset of the points (3x3).
+//  - ceres::Covariance with the SPARSE_QR algorithm (SuiteSparseQR when it is available, else Eigen's sparse QR), and only the
+//    diagonal blocks of the cameras and of the selected points are requested. Thus only those blocks are recovered from the
+//    sparse R factor, and no dense inverse (nor dense reduced camera system) is ever formed.
+//  - BA is only defined up to a similarity (7 dof), which makes the Jacobian rank deficient. The gauge is fixed by holding
+//    the pose of the first camera (its intrinsics stay free) and one translation component of the second camera (scale)
+//    constant, with SubsetManifolds. Thus the covariances are relative to the first camera.
+//  - The points observed by less than two cameras have no defined covariance, they are left out of the problem
+//    (and out of the output) instead of making the whole Jacobian rank deficient.
+class CovarianceEstimator {
+public:
+  static constexpr int kCameraBlockSize = 9;
+  static constexpr int kPointBlockSize = 3;
+  static constexpr int kCameraPackedSize = kCameraBlockSize * (kCameraBlockSize + 1) / 2; // upper triangle only
+  static constexpr int kPointPackedSize = kPointBlockSize * (kPointBlockSize + 1) / 2;
+
+public:
+  explicit CovarianceEstimator(BALManager& _balManager) : balManager_(_balManager) {}
+
+  void selectPoints(int _stride); // every _stride-th point (0 selects none)
+  void selectPoints(const std::vector<int>& _point_indices) { point_indices_ = _point_indices; }
+
+  // _pruner (optional) restricts the problem to the observations kept by the outlier pruning.
+  bool compute(int _num_threads, const OutlierPruner* _pruner = nullptr);
+
+  // Compact binary layout (little-endian, as written by the host):
+  //   char[8] "BALCOV1", int32 num_cameras, int32 num_points,
+  //   num_cameras x { int32 camera index, double[45] upper triangle (row-major) },
+  //   num_points  x { int32 point index,  double[6]  upper triangle (row-major) }
+  bool writeBinary(const std::string& _filename) const;
+
+  int num_camera_covariances() const { return static_cast<int>(camera_indices_.size()); }
+  int num_point_covariances() const { return static_cast<int>(covariance_point_indices_.size()); }
+
+private:
+  void fixGauge(ceres::Problem& _problem) const;
+  bool fail(const std::string& _reason);
+
+  template <int kSize>
+  static void packUpperTriangle(const double* _full, std::vector<double>& _packed) {
+    for (int r = 0; r < kSize; ++r)
+      for (int c = r; c < kSize; ++c)
+        _packed.push_back(_full[r*kSize + c]);
+  }
+
+private:
+  BALManager& balManager_;
+  std::vector<int> point_indices_;             // requested
+  std::vector<int> camera_indices_;            // computed (the cameras present in the problem)
+  std::vector<int> covariance_point_indices_;  // computed (the requested points present in the problem)
+  std::vector<double> camera_covariances_;     // kCameraPackedSize per camera
+  std::vector<double> point_covariances_;      // kPointPackedSize per point
+};
+
+} // namespace simplebal
+
+
+void simplebal::CovarianceEstimator::selectPoints(int _stride) {
+  point_indices_.clear();
+  if (_stride <= 0)
+    return;
+  for (int i = 0; i < balManager_.num_points(); i += _stride)
+    point_indices_.push_back(i);
+} // selectPoints
+
+void simplebal::CovarianceEstimator::fixGauge(ceres::Problem& _problem) const {
+  if (camera_indices_.size() < 2) {
+    LOG(WARNING) << "Less than two cameras in the problem, the gauge is left free.";
+    return;
+  }
+
+  // the rotation and the translation of the first camera
+  double* first_camera = balManager_.mutable_cameras() + 9*camera_indices_[0];
+  double* second_camera = balManager_.mutable_cameras() + 9*camera_indices_[1];
+  _problem.SetManifold(first_camera, new ceres::SubsetManifold(kCameraBlockSize, {0, 1, 2, 3, 4, 5}));
+
+  // scaling the scene about the first camera center c1 changes t2 along -R2 (c2 - c1), so fix its largest component.
+  double first_center[3], second_center[3], baseline[3], rotated_baseline[3];
+  balManager_.cameraToCenter(first_camera, first_center);
+  balManager_.cameraToCenter(second_camera, second_center);
+  for (int k = 0; k < 3; ++k)
+    baseline[k] = second_center[k] - first_center[k];
+  ceres::AngleAxisRotatePoint(second_camera, baseline, rotated_baseline);
+
+  int scale_component = 0;
+  for (int k = 1; k < 3; ++k) {
+    if (std::abs(rotated_baseline[k]) > std::abs(rotated_baseline[scale_component]))
+      scale_component = k;
+  }
+  _problem.SetManifold(second_camera, new ceres::SubsetManifold(kCameraBlockSize, {3 + scale_component}));
+} // fixGauge
+
+bool simplebal::CovarianceEstimator::fail(const std::string& _reason) {
+  LOG(ERROR) << "Covariance computation failed (" << _reason << ").";
+  camera_indices_.clear();
+  covariance_point_indices_.clear();
+  camera_covariances_.clear();
+  point_covariances_.clear();
+  return false;
+} // fail
+
+bool simplebal::CovarianceEstimator::compute(int _num_threads, const OutlierPruner* _pruner) {
+  camera_indices_.clear();
+  covariance_point_indices_.clear();
+  camera_covariances_.clear();
+  point_covariances_.clear();
+
+  // the observations in use, without the points seen by less than two cameras
+  const int num_observations = balManager_.num_observations();
+  auto isUsed = [&](int i) { return _pruner == nullptr || _pruner->isInlier(i); };
+  std::vector<int> num_point_observations(balManager_.num_points(), 0);
+  for (int i = 0; i < num_observations; ++i) {
+    if (isUsed(i))
+      num_point_observations[balManager_.point_index(i)]++;
+  }
+
+  // a problem of its own with the plain squared loss, since the solved one may hold a robust loss or normalized observations
+  ceres::Problem problem;
+  const double* observations = balManager_.observations();
+  for (int i = 0; i < num_observations; ++i) {
+    if (!isUsed(i) || num_point_observations[balManager_.point_index(i)] < 2)
+      continue;
+    problem.AddResidualBlock(simplebal::genSnavelyReprojectionError(observations[2*i + 0], observations[2*i + 1]),
+                             NULL,
+                             balManager_.mutable_camera_for_observation(i),
+                             balManager_.mutable_point_for_observation(i));
+  }
+  const int num_dropped_points = static_cast<int>(std::count(num_point_observations.begin(), num_point_observations.end(), 1));
+  if (num_dropped_points > 0)
+    LOG(WARNING) << num_dropped_points << " points seen by a single camera are left out of the covariances.";
+
+  std::vector<std::pair<const double*, const double*>> covariance_blocks;
+  for (int i = 0; i < balManager_.num_cameras(); ++i) {
+    const double* camera = balManager_.mutable_cameras() + 9*i;
+    if (problem.HasParameterBlock(camera)) {
+      camera_indices_.push_back(i);
+      covariance_blocks.push_back(std::make_pair(camera, camera));
+    }
+  }
+  if (camera_indices_.empty())
+    return fail("no observations");
+  fixGauge(problem);
+
+  for (int i: point_indices_) {
+    if (i < 0 || i >= balManager_.num_points())
+      continue;
+    const double* point = balManager_.mutable_points() + 3*i;
+    if (problem.HasParameterBlock(point)) {
+      covariance_point_indices_.push_back(i);
+      covariance_blocks.push_back(std::make_pair(point, point));
+    }
+  }
+
+  ceres::Covariance::Options options;
+  options.algorithm_type = ceres::SPARSE_QR;
+  options.sparse_linear_algebra_library_type = ceres::IsSparseLinearAlgebraLibraryTypeAvailable(ceres::SUITE_SPARSE) 
+                                             ? ceres::SUITE_SPARSE : ceres::EIGEN_SPARSE;
+  options.num_threads = std::max(1, _num_threads);
+  ceres::Covariance covariance(options);
+  if (!covariance.Compute(covariance_blocks, &problem))
+    return fail("the Jacobian is rank deficient, e.g., a degenerate camera or a point at infinity");
+
+  // in the ambient space, so the fixed (gauge) directions have zero rows and columns
+  double camera_block[kCameraBlockSize * kCameraBlockSize];
+  camera_covariances_.reserve(kCameraPackedSize * camera_indices_.size());
+  for (int i: camera_indices_) {
+    const double* camera = balManager_.mutable_cameras() + 9*i;
+    if (!covariance.GetCovarianceBlock(camera, camera, camera_block))
+      return fail("camera " + std::to_string(i));
+    packUpperTriangle<kCameraBlockSize>(camera_block, camera_covariances_);
+  }
+
+  double point_block[kPointBlockSize * kPointBlockSize];
+  point_covariances_.reserve(kPointPackedSize * covariance_point_indices_.size());
+  for (int i: covariance_point_indices_) {
+    const double* point = balManager_.mutable_points() + 3*i;
+    if (!covariance.GetCovarianceBlock(point, point, point_block))
+      return fail("point " + std::to_string(i));
+    packUpperTriangle<kPointBlockSize>(point_block, point_covariances_);
+  }
+
+  return true;
+} // compute
+
+bool simplebal::CovarianceEstimator::writeBinary(const std::string& _filename) const {
+  std::ofstream writeFile(_filename.data(), std::ios::binary);
+  if (!writeFile.is_open())
+    return false;
+
+  const char magic[8] = "BALCOV1";
+  const int32_t num_cameras = static_cast<int32_t>(camera_indices_.size());
+  const int32_t num_points = static_cast<int32_t>(covariance_point_indices_.size());
+  writeFile.write(magic, sizeof(magic));
+  writeFile.write(reinterpret_cast<const char*>(&num_cameras), sizeof(num_cameras));
+  writeFile.write(reinterpret_cast<const char*>(&num_points), sizeof(num_points));
+
+  for (int i = 0; i < num_cameras; ++i) {
+    const int32_t index = camera_indices_[i];
+    writeFile.write(reinterpret_cast<const char*>(&index), sizeof(index));
+    writeFile.write(reinterpret_cast<const char*>(camera_covariances_.data() + kCameraPackedSize*i), sizeof(double) * kCameraPackedSize);
+  }
+  for (int i = 0; i < num_points; ++i) {
+    const int32_t index = covariance_point_indices_[i];
+    writeFile.write(reinterpret_cast<const char*>(&index), sizeof(index));
+    writeFile.write(reinterpret_cast<const char*>(point_covariances_.data() + kPointPackedSize*i), sizeof(double) * kPointPackedSize);
+  }
+
+  return writeFile.good();
+} // writeBinary
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#include "ceres/ceres.h"
+
+#include "Profiling/ResidualProfiler.h"
+
+#include "SimpleBAL/BALManager.h"
+#include "SimpleBAL/OptionConfig.h"
+#include "SimpleBAL/Residual.h"
+
+namespace simplebal {
+
+// Incremental bundle adjustment for an SfM front end that delivers the cameras in batches.
+//  - cameras, points and observations are appended to a live ceres::Problem (never rebuilt), 
+//    and the parameters live in deques, so the pointers handed to ceres stay valid while growing.
+//  - solveBatch() runs a local BA over the affected neighborhood only: the points of the observations added since the last batch, 
+//    and every residual of those points (the older cameras in them are held constant). Every _global_every batches, a global BA follows.
+//  - the local problems borrow the cost functions owned by the global problem, thus nothing is re-created per batch.
+class IncrementalBundleAdjuster {
+public:
+  struct BatchStats {
+    int num_cameras;          // in total, after the batch
+    int num_local_residuals;  // 0 if the local BA is disabled
+    int num_local_iterations;
+    bool global;
+    int num_global_iterations;
+    double time_in_seconds;
+  };
+
+public:
+  // _local_ba = false gives the baseline that re-solves the whole problem after every batch (with _global_every = 1).
+  // With a _profiler, every cost function is wrapped by it (see Profiling/ResidualProfiler.h).
+  IncrementalBundleAdjuster(const ceres::Solver::Options& _options, int _global_every, bool _local_ba = true,
+                            profiling::ResidualProfiler* _profiler = nullptr);
+
+  int addCamera(const double* _camera);  // returns the camera id
+  int addPoint(const double* _point);    // returns the point id
+  void addObservation(int _camera_id, int _point_id, double _observed_x, double _observed_y);
+
+  BatchStats solveBatch();
+  int solveLocal();  // returns the number of local residuals
+  void solveGlobal();
+
+  int num_cameras() const { return static_cast<int>(cameras_.size()); }
+  int num_points() const { return static_cast<int>(points_.size()); }
+  const double* camera(int _camera_id) const { return cameras_[_camera_id].data(); }
+  const double* point(int _point_id) const { return points_[_point_id].data(); }
+
+private:
+  struct Observation {
+    int camera_id;
+    int point_id;
+    ceres::CostFunction* cost_function; // owned by global_problem_
+  };
+
+private:
+  ceres::Solver::Options options_;
+  const int global_every_;
+  const bool local_ba_;
+  profiling::ResidualProfiler* profiler_;
+
+  std::deque<std::array<double, 9>> cameras_;
+  std::deque<std::array<double, 3>> points_;
+  std::vector<Observation> observations_;
+  std::vector<std::vector<int>> point_observations_; // observation ids of each point
+
+  ceres::Problem global_problem_;
+  int first_new_camera_ {0};      // the cameras [first_new_camera_, num_cameras()) are added since the last batch
+  int first_new_observation_ {0}; // and so are the observations [first_new_observation_, observations_.size())
+  int num_batches_ {0};
+  int num_last_iterations_ {0};
+};
+
+// Replays a loaded BAL problem as a sequence of batches of _batch_size cameras (in the camera order of the file), 
+// i.e., as the front end would deliver it, and copies the final estimate back into _balManager. 
+// Returns the cumulative time spent in the solves.
+double replayIncrementally(BALManager& _balManager, const ceres::Solver::Options& _options,
+                           int _batch_size, int _global_every, bool _local_ba = true,
+                           profiling::ResidualProfiler* _profiler = nullptr);
+
+} // namespace simplebal
+
+
+simplebal::IncrementalBundleAdjuster::IncrementalBundleAdjuster(const ceres::Solver::Options& _options, int _global_every, bool _local_ba,
+                                                                 profiling::ResidualProfiler* _profiler)
+: options_(_options),
+  global_every_(std::max(1, _global_every)),
+  local_ba_(_local_ba),
+  profiler_(_profiler)
+{
+  options_.minimizer_progress_to_stdout = false;
+  options_.update_state_every_iteration = false;
+  options_.callbacks.clear();
+} // IncrementalBundleAdjuster
+
+int simplebal::IncrementalBundleAdjuster::addCamera(const double* _camera) {
+  std::array<double, 9> camera;
+  std::copy(_camera, _camera + 9, camera.begin());
+  cameras_.push_back(camera);
+  return num_cameras() - 1;
+} // addCamera
+
+int simplebal::IncrementalBundleAdjuster::addPoint(const double* _point) {
+  std::array<double, 3> point;
+  std::copy(_point, _point + 3, point.begin());
+  points_.push_back(point);
+  point_observations_.emplace_back();
+  return num_points() - 1;
+} // addPoint
+
+void simplebal::IncrementalBundleAdjuster::addObservation(int _camera_id, int _point_id, double _observed_x, double _observed_y) {
+  auto cost_function = simplebal::genSnavelyReprojectionError(_observed_x, _observed_y);
+  if (profiler_ != nullptr)
+    cost_function = profiler_->wrap(cost_function, "SnavelyReprojectionError");
+  global_problem_.AddResidualBlock(cost_function, NULL, cameras_[_camera_id].data(), points_[_point_id].data());
+
+  point_observations_[_point_id].push_back(static_cast<int>(observations_.size()));
+  observations_.push_back(Observation {_camera_id, _point_id, cost_function});
+} // addObservation
+
+int simplebal::IncrementalBundleAdjuster::solveLocal() {
+  // the local problem only borrows the cost functions
+  ceres::Problem::Options problem_options;
+  problem_options.cost_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem local_problem(problem_options);
+
+  std::vector<char> point_added(points_.size(), 0);
+  for (int k = first_new_observation_; k < static_cast<int>(observations_.size()); ++k) {
+    const Observation& observation = observations_[k];
+    if (point_added[observation.point_id])
+      continue;
+    point_added[observation.point_id] = 1;
+
+    for (int i: point_observations_[observation.point_id]) {
+      const Observation& neighbor = observations_[i];
+      local_problem.AddResidualBlock(neighbor.cost_function, NULL, 
+                                     cameras_[neighbor.camera_id].data(), points_[neighbor.point_id].data());
+    }
+  }
+
+  const int num_local_residuals = local_problem.NumResidualBlocks();
+  if (num_local_residuals == 0)
+    return 0;
+
+  // the older cameras anchor the neighborhood (and the gauge); in the very first batch, the first camera does.
+  bool has_constant_camera = false;
+  for (int i = 0; i < first_new_camera_; ++i) {
+    if (local_problem.HasParameterBlock(cameras_[i].data())) {
+      local_problem.SetParameterBlockConstant(cameras_[i].data());
+      has_constant_camera = true;
+    }
+  }
+  if (!has_constant_camera && first_new_camera_ < num_cameras() && local_problem.HasParameterBlock(cameras_[first_new_camera_].data()))
+    local_problem.SetParameterBlockConstant(cameras_[first_new_camera_].data());
+
+  ceres::Solver::Summary summary;
+  ceres::Solve(options_, &local_problem, &summary);
+  num_last_iterations_ = static_cast<int>(summary.iterations.size());
+  return num_local_residuals;
+} // solveLocal
+
+void simplebal::IncrementalBundleAdjuster::solveGlobal() {
+  if (global_problem_.NumResidualBlocks() == 0)
+    return;
+
+  // fix the gauge by the first camera (the global problem keeps it constant from now on)
+  if (global_problem_.HasParameterBlock(cameras_[0].data()))
+    global_problem_.SetParameterBlockConstant(cameras_[0].data());
+
+  ceres::Solver::Summary summary;
+  ceres::Solve(options_, &global_problem_, &summary);
+  num_last_iterations_ = static_cast<int>(summary.iterations.size());
+} // solveGlobal
+
+simplebal::IncrementalBundleAdjuster::BatchStats simplebal::IncrementalBundleAdjuster::solveBatch() {
+  const auto start = std::chrono::steady_clock::now();
+
+  BatchStats stats {num_cameras(), 0, 0, false, 0, 0.0};
+  if (local_ba_) {
+    stats.num_local_residuals = solveLocal();
+    stats.num_local_iterations = num_last_iterations_;
+  }
+
+  num_batches_++;
+  if (num_batches_ % global_every_ == 0) {
+    solveGlobal();
+    stats.global = true;
+    stats.num_global_iterations = num_last_iterations_;
+  }
+
+  first_new_camera_ = num_cameras();
+  first_new_observation_ = static_cast<int>(observations_.size());
+  stats.time_in_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return stats;
+} // solveBatch
+
+double simplebal::replayIncrementally(BALManager& _balManager, const ceres::Solver::Options& _options,
+                                      int _batch_size, int _global_every, bool _local_ba,
+                                      profiling::ResidualProfiler* _profiler) {
+  std::vector<std::vector<int>> camera_observations(_balManager.num_cameras());
+  for (int i = 0; i < _balManager.num_observations(); ++i)
+    camera_observations[_balManager.camera_index(i)].push_back(i);
+
+  IncrementalBundleAdjuster adjuster(_options, _global_every, _local_ba, _profiler);
+  std::vector<int> camera_ids(_balManager.num_cameras(), -1);
+  std::vector<int> point_ids(_balManager.num_points(), -1);
+  const double* observations = _balManager.observations();
+
+  double total_time = 0.0;
+  const int batch_size = std::max(1, _batch_size);
+  for (int begin = 0; begin < _balManager.num_cameras(); begin += batch_size) {
+    const int end = std::min(begin + batch_size, _balManager.num_cameras());
+    for (int c = begin; c < end; ++c) {
+      camera_ids[c] = adjuster.addCamera(_balManager.mutable_cameras() + 9*c);
+      for (int i: camera_observations[c]) {
+        const int p = _balManager.point_index(i);
+        if (point_ids[p] < 0)
+          point_ids[p] = adjuster.addPoint(_balManager.mutable_points() + 3*p);
+        adjuster.addObservation(camera_ids[c], point_ids[p], observations[2*i + 0], observations[2*i + 1]);
+      }
+    }
+
+    const auto stats = adjuster.solveBatch();
+    total_time += stats.time_in_seconds;
+    cout << "batch - cameras: " << stats.num_cameras
+         << ", local residuals: " << stats.num_local_residuals << " (" << stats.num_local_iterations << " iterations)"
+         << (stats.global ? ", global BA (" + std::to_string(stats.num_global_iterations) + " iterations)" : std::string(""))
+         << ", time: " << stats.time_in_seconds << " sec, cumulative: " << total_time << " sec" << endl;
+  }
+
+  // the last batches may not have been followed by a global BA
+  if (_local_ba) {
+    const auto start = std::chrono::steady_clock::now();
+    adjuster.solveGlobal();
+    total_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  for (int c = 0; c < _balManager.num_cameras(); ++c)
+    std::copy(adjuster.camera(camera_ids[c]), adjuster.camera(camera_ids[c]) + 9, _balManager.mutable_cameras() + 9*c);
+  for (int p = 0; p < _balManager.num_points(); ++p) {
+    if (point_ids[p] >= 0)
+      std::copy(adjuster.point(point_ids[p]), adjuster.point(point_ids[p]) + 3, _balManager.mutable_points() + 3*p);
+  }
+
+  return total_time;
+} // replayIncrementally
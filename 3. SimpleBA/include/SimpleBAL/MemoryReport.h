@@ -0,0 +1,140 @@
+#pragma once
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ceres/ceres.h"
+
+#include "Profiling/ResidualProfiler.h"
+
+#include "SimpleBAL/BALManager.h"
+#include "SimpleBAL/Residual.h"
+
+namespace simplebal {
+
+// The resident set size now (from /proc/self/statm), and its peak so far (getrusage), in bytes.
+size_t residentMemoryBytes();
+size_t peakResidentMemoryBytes();
+
+// The heap held by each SnavelyReprojectionError residual: the AutoDiffCostFunction, its functor, 
+// and the vector of its parameter block sizes, each with the (typical, 16 bytes) overhead of malloc.
+// _profiled adds the ProfiledCostFunction around it (with its own vector of sizes) and its registration in the profiler;
+// the per-thread counters of the profiler are allocated during the solve, and are counted in the solver workspace.
+size_t estimatedCostFunctionBytes(bool _profiled = false);
+
+// Memory footprint of a solve, to size the batch nodes by their peak RSS:
+// the resident set is sampled at each stage (the baseline before the load, after the load, after the problem construction,
+// and at the end of the solve with its peak), and the difference between the stages is broken down into
+// the loader arrays of BALManager, the cost functions, the Problem (its residual and parameter blocks), and the solver workspace.
+// Added to the solver callbacks, it also samples the resident set at each iteration, while the solver workspace is allocated.
+class MemoryReport : public ceres::IterationCallback {
+public:
+  MemoryReport() { mark("baseline"); }
+
+  ceres::CallbackReturnType operator()(const ceres::IterationSummary&) override {
+    max_solve_rss_ = std::max(max_solve_rss_, residentMemoryBytes());
+    return ceres::SOLVER_CONTINUE;
+  }
+
+  void mark(const std::string& _stage); // samples and prints the rss and the peak rss
+  void print(const BALManager& _balManager, int _num_residual_blocks, const BALManager::MemoryUsage& _loaded, bool _profiled = false) const;
+
+private:
+  struct Sample {
+    std::string stage;
+    size_t rss;
+    size_t peak_rss;
+  };
+  const Sample* find(const std::string& _stage) const;
+
+private:
+  std::vector<Sample> samples_;
+  size_t max_solve_rss_ {0};
+}; // MemoryReport
+
+} // namespace simplebal
+
+
+size_t simplebal::residentMemoryBytes() {
+  long pages_total = 0, pages_resident = 0;
+  FILE* fptr = fopen("/proc/self/statm", "r");
+  if (fptr == NULL)
+    return 0;
+  if (fscanf(fptr, "%ld %ld", &pages_total, &pages_resident) != 2)
+    pages_resident = 0;
+  fclose(fptr);
+  return static_cast<size_t>(pages_resident) * sysconf(_SC_PAGESIZE);
+} // residentMemoryBytes
+
+size_t simplebal::peakResidentMemoryBytes() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<size_t>(usage.ru_maxrss) * 1024; // kilobytes on Linux
+} // peakResidentMemoryBytes
+
+size_t simplebal::estimatedCostFunctionBytes(bool _profiled) {
+  constexpr size_t kMallocOverhead = 16;
+  size_t bytes = sizeof(ceres::AutoDiffCostFunction<SnavelyReprojectionError, 2, 9, 3>) + kMallocOverhead
+               + sizeof(SnavelyReprojectionError) + kMallocOverhead
+               + 2 * sizeof(int32_t) + kMallocOverhead;
+#ifdef ENABLE_RESIDUAL_PROFILER
+  if (_profiled)
+    bytes += sizeof(profiling::ProfiledCostFunction) + kMallocOverhead
+           + 2 * sizeof(int32_t) + kMallocOverhead
+           + 2 * sizeof(int); // the block entry (type and index) of the profiler
+#else
+  (void)_profiled; // wrap() adds nothing without the profiler
+#endif
+  return bytes;
+} // estimatedCostFunctionBytes
+
+void simplebal::MemoryReport::mark(const std::string& _stage) {
+  samples_.push_back(Sample {_stage, residentMemoryBytes(), peakResidentMemoryBytes()});
+  printf("memory [%s] rss: %.1f MB, peak rss: %.1f MB\n", _stage.c_str(), 
+         samples_.back().rss / 1048576.0, samples_.back().peak_rss / 1048576.0);
+} // mark
+
+const simplebal::MemoryReport::Sample* simplebal::MemoryReport::find(const std::string& _stage) const {
+  for (const auto& _sample: samples_)
+    if (_sample.stage == _stage)
+      return &_sample;
+  return nullptr;
+} // find
+
+void simplebal::MemoryReport::print(const BALManager& _balManager, int _num_residual_blocks, const BALManager::MemoryUsage& _loaded, 
+                                    bool _profiled) const {
+  const Sample* baseline = find("baseline");
+  const Sample* loaded = find("load");
+  const Sample* constructed = find("construction");
+  const Sample* solved = find("solve");
+  if (baseline == nullptr || loaded == nullptr || constructed == nullptr || solved == nullptr) {
+    std::cerr << "WARNING: the memory report needs the baseline, load, construction and solve stages\n";
+    return;
+  }
+  auto megabytes = [](double _bytes) { return _bytes / 1048576.0; };
+  auto difference = [](size_t _a, size_t _b) { return (_a > _b) ? static_cast<double>(_a - _b) : 0.0; };
+
+  const size_t cost_function_bytes = estimatedCostFunctionBytes(_profiled);
+  const double cost_functions = static_cast<double>(cost_function_bytes) * _num_residual_blocks;
+  const double problem = difference(constructed->rss, loaded->rss) - cost_functions;
+  const double workspace = difference(std::max(max_solve_rss_, solved->rss), constructed->rss);
+  const double total = difference(solved->peak_rss, baseline->rss);
+  const BALManager::MemoryUsage held = _balManager.memoryUsage();
+
+  printf("\nMemory footprint (%d observations)\n", _balManager.num_observations());
+  printf("  loader arrays     : %8.1f MB (indices %.1f, observations %.1f, parameters %.1f), %.1f MB still held\n",
+         megabytes(_loaded.total()), megabytes(_loaded.indices), megabytes(_loaded.observations), megabytes(_loaded.parameters),
+         megabytes(held.total()));
+  printf("  cost functions    : %8.1f MB (estimated, %zu bytes x %d%s)\n", 
+         megabytes(cost_functions), cost_function_bytes, _num_residual_blocks, _profiled ? ", profiled" : "");
+  printf("  problem           : %8.1f MB (rss growth of the construction, less the cost functions)\n", megabytes(problem));
+  printf("  solver workspace  : %8.1f MB (max rss during the solve, less the rss before it)\n", megabytes(workspace));
+  printf("  peak, over baseline: %7.1f MB, %.0f bytes per observation\n", 
+         megabytes(total), total / std::max(1, _balManager.num_observations()));
+} // print
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "ceres/ceres.h"
+
+#include "MiniBatch/MiniBatch.h"
+#include "Profiling/ResidualProfiler.h"
+
+#include "SimpleBAL/BALManager.h"
+#include "SimpleBAL/Residual.h"
+
+namespace simplebal {
+
+// Stochastic mini-batch warm phase: the early LM iterations over all the observations are expensive, but only need a rough gradient.
+// Thus the first phases solve a few iterations on growing random subsets of the observations (resampled from the observation 
+// arrays of BALManager in each phase), and the final phase runs on the full problem. The cameras and points that are not observed
+// in a subset are simply not in its problem, so they keep their values until they are sampled.
+// The options, the phase statistics and timeToCost are shared with 2. CurveFitting (MiniBatch/MiniBatch.h of the repository root).
+using minibatch::MiniBatchOptions;
+using minibatch::MiniBatchPhaseStats;
+using minibatch::timeToCost;
+
+// _final_summary (optional) receives the summary of the final phase. With a _profiler, every cost function of every phase
+// is wrapped by it (see Profiling/ResidualProfiler.h).
+std::vector<MiniBatchPhaseStats> solveWithMiniBatches(BALManager& _balManager, const ceres::Solver::Options& _options, 
+                                                      const MiniBatchOptions& _minibatch_options,
+                                                      ceres::Solver::Summary* _final_summary = nullptr,
+                                                      profiling::ResidualProfiler* _profiler = nullptr);
+
+} // namespace simplebal
+
+
+std::vector<simplebal::MiniBatchPhaseStats> simplebal::solveWithMiniBatches(BALManager& _balManager, const ceres::Solver::Options& _options, 
+                                                                              const MiniBatchOptions& _minibatch_options,
+                                                                              ceres::Solver::Summary* _final_summary,
+                                                                              profiling::ResidualProfiler* _profiler) {
+  std::vector<MiniBatchPhaseStats> stats;
+  const int num_observations = _balManager.num_observations();
+  const double* observations = _balManager.observations();
+
+  std::mt19937 random(_minibatch_options.seed);
+  std::vector<int> indices(num_observations);
+  std::iota(indices.begin(), indices.end(), 0);
+
+  ceres::Solver::Options phase_options = _options;
+  phase_options.max_num_iterations = _minibatch_options.phase_max_iterations;
+
+  double fraction = _minibatch_options.initial_fraction;
+  while (true) {
+    const auto start = std::chrono::steady_clock::now();
+    const int batch_size = (fraction < 1.0) ? std::max(_minibatch_options.min_batch_size, static_cast<int>(std::ceil(fraction * num_observations)))
+                                            : num_observations;
+    const bool is_final = (batch_size >= num_observations);
+
+    // a fresh sample without replacement (partial Fisher-Yates) in each phase
+    if (!is_final) {
+      for (int i = 0; i < batch_size; ++i) {
+        std::uniform_int_distribution<int> pick(i, num_observations - 1);
+        std::swap(indices[i], indices[pick(random)]);
+      }
+    }
+
+    ceres::Problem problem;
+    for (int k = 0; k < (is_final ? num_observations : batch_size); ++k) {
+      const int i = is_final ? k : indices[k];
+      auto cost_function = simplebal::genSnavelyReprojectionError(observations[2*i + 0], observations[2*i + 1]);
+      if (_profiler != nullptr)
+        cost_function = _profiler->wrap(cost_function, "SnavelyReprojectionError");
+      problem.AddResidualBlock(cost_function,
+                               NULL,
+                               _balManager.mutable_camera_for_observation(i),
+                               _balManager.mutable_point_for_observation(i));
+    }
+
+    ceres::Solver::Summary summary;
+    ceres::Solve(is_final ? _options : phase_options, &problem, &summary);
+
+    stats.push_back(MiniBatchPhaseStats {problem.NumResidualBlocks(), static_cast<int>(summary.iterations.size()),
+                                         std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+                                         summary.final_cost});
+    std::cout << (is_final ? "final phase" : "mini-batch phase") << " - observations: " << stats.back().batch_size
+         << ", iterations: " << stats.back().num_iterations << ", cost: " << stats.back().final_cost
+         << ", time: " << stats.back().time_in_seconds << " sec" << std::endl;
+
+    if (is_final) {
+      if (_final_summary != nullptr)
+        *_final_summary = summary;
+      break;
+    }
+    fraction *= std::max(_minibatch_options.growth, 1.0 + 1e-3);
+  }
+
+  return stats;
+} // solveWithMiniBatches
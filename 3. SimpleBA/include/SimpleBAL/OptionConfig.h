@@ -1,8 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <vector>
 #include <string>
 
+#include "gflags/gflags.h"
+
 #include "ceres/ceres.h"
 #include "ceres/loss_function.h"
 
@@ -13,6 +17,114 @@ using std::endl;
 using std::string;
 // using ceres::internal::StringPrintf;
 
+DEFINE_int32(num_threads, 1,
+             "Number of threads used by the solver and by the parallel post-solve stages.");
+
+DEFINE_int32(pruning_rounds, 1,
+             "Number of solve rounds. With more than one round, the first round "
+             "is a short solve with a robust loss, after which the outlier "
+             "observations are pruned and the later rounds use the squared loss.");
+
+DEFINE_int32(robust_round_iterations, 10,
+             "Maximum number of iterations of the first (robust) pruning round.");
+
+DEFINE_double(robust_loss_scale, 0.5,
+              "Scale (in pixels) of the CauchyLoss used by the first pruning round.");
+
+DEFINE_double(outlier_threshold, 4.0,
+              "Reprojection error (in pixels) above which an observation is pruned.");
+
+DEFINE_bool(normalize, false,
+            "Center and scale the scene before solving (the results are mapped back before writing).");
+
+DEFINE_bool(normalize_cameras, false,
+            "With --normalize, also divide the focal lengths and the observations by the median focal length.");
+
+DEFINE_bool(compare_normalization, false,
+            "Solve the input twice from the same values, as it is and normalized (--normalize_cameras applies), "
+            "and print the iterations, the time and the final cost (in input pixels) of both.");
+
+DEFINE_int32(synthetic_cameras, 0,
+             "If positive, solve a synthetic scene with this many cameras instead of an input file (see BALManager::generateSynthetic).");
+
+DEFINE_int32(synthetic_points, 2000,
+             "The number of points of the synthetic scene.");
+
+DEFINE_int32(synthetic_observations_per_point, 4,
+             "The number of cameras observing each point of the synthetic scene.");
+
+DEFINE_double(synthetic_offset, 1000.0,
+              "The center of the synthetic scene (on each axis), far from the origin as in the raw datasets.");
+
+DEFINE_double(synthetic_scale, 50.0,
+              "The radius of the point cloud of the synthetic scene.");
+
+DEFINE_double(point_motion_tolerance, 0.0,
+              "Stop the solve once no landmark moves more than this (in the input units) in an iteration. 0 disables it.");
+
+DEFINE_double(translation_motion_tolerance, 0.0,
+              "With --point_motion_tolerance, also require every camera center to move less than this (in the input units).");
+
+DEFINE_double(rotation_motion_tolerance, 0.0,
+              "With --point_motion_tolerance, also require every camera rotation (angle-axis) to change less than this (in radians).");
+
+DEFINE_bool(compare_motion_tolerance, false,
+            "Solve the input twice from the same values, without and with the --*_motion_tolerance termination, "
+            "and print the iterations, the time and the final cost (in input pixels) of both.");
+
+DEFINE_string(covariance_file, "",
+              "If not empty, the marginal covariances of the cameras (and of the points selected by --covariance_point_stride) "
+              "are computed after the solve and written to this file in binary.");
+
+DEFINE_int32(covariance_point_stride, 0,
+             "Compute the covariance of every n-th point. 0 computes the cameras only.");
+
+DEFINE_string(checkpoint_file, "",
+              "If not empty, the solver state is saved to this file every --checkpoint_every iterations.");
+
+DEFINE_int32(checkpoint_every, 10,
+             "Number of iterations between two checkpoints.");
+
+DEFINE_bool(resume, false,
+            "Resume from --checkpoint_file (iteration count and trust region radius included), instead of the input parameters.");
+
+DEFINE_int32(incremental_batch_size, 0,
+             "If positive, replay the input as batches of this many cameras through the incremental BA (local BA per batch).");
+
+DEFINE_int32(incremental_global_every, 5,
+             "Run a global BA after every n batches of the incremental BA.");
+
+DEFINE_bool(incremental_compare_full, false,
+            "With --incremental_batch_size, also time the baseline that re-solves the whole problem after every batch.");
+
+DEFINE_double(minibatch_initial_fraction, 0.0,
+              "If positive, warm up on random subsets of the observations, starting with this fraction of them (see MiniBatch.h).");
+
+DEFINE_double(minibatch_growth, 3.0,
+              "Growth of the subset fraction from one mini-batch phase to the next.");
+
+DEFINE_int32(minibatch_phase_iterations, 5,
+             "Maximum number of iterations of each mini-batch phase.");
+
+DEFINE_bool(profile_residuals, false,
+            "Wrap every cost function with the evaluation profiler, and print its report after the solve "
+            "(needs the ENABLE_RESIDUAL_PROFILER build option).");
+
+DEFINE_int32(profile_top_k, 10,
+             "The number of the slowest residual blocks in the profiler report.");
+
+DEFINE_bool(memory_report, false,
+            "Print the resident memory after the load, after the problem construction and at the peak of the solve, "
+            "broken down into the loader arrays, the cost functions, the problem and the solver workspace.");
+
+DEFINE_bool(low_memory, false,
+            "Free the index and observation arrays once the residual blocks are built (the default solve only). "
+            "Not with --covariance_file, which rebuilds the problem from the observations.");
+
+DEFINE_bool(low_memory_solver, false,
+            "Solve with ITERATIVE_SCHUR + SCHUR_JACOBI, which never forms the reduced camera matrix (the default solve only). "
+            "It changes the linear solver, so the iterations and the final cost differ from the default DENSE_SCHUR solve.");
+
 namespace simplebal {
 
 // see here for details 
@@ -28,14 +140,17 @@ void setSolverOptions(ceres::Solver::Options& _options)
   _options.max_num_iterations = 200;
   _options.function_tolerance = 1e-7;
 
+  _options.num_threads = FLAGS_num_threads;
+
   // _options.update_state_every_iteration = true;
 }
 
 struct WritingMidResultsCallback : public ceres::IterationCallback 
 {
 public:
-  explicit WritingMidResultsCallback(simplebal::BALManager& _balManager) 
-  : balManager(_balManager) 
+  // _first_iteration continues the file numbering of a resumed solve (see --resume)
+  explicit WritingMidResultsCallback(simplebal::BALManager& _balManager, int _first_iteration = 0) 
+  : balManager(_balManager), iterCounter(_first_iteration) 
   { 
     balManager.writeResultFile(); 
   }
@@ -55,5 +170,117 @@ public:
 };
 
 
+// Stops the solve once the landmarks (and optionally the cameras) move less than the given physical tolerances in an iteration,
+// since the last iterations of a BA typically move the points by far less than the sensor noise.
+// The motion is the difference against a copy of the previous state, thus options.update_state_every_iteration must be true.
+// The camera motion is the displacement of the camera center (c = -R^T t) in the input frame, not of the translation vector t,
+// which also moves when only the rotation changes.
+struct MotionToleranceCallback : public ceres::IterationCallback 
+{
+public:
+  struct Motion {
+    double max_point;
+    double rms_point;
+    double max_translation;
+    double rms_translation;
+    double max_rotation;
+    double rms_rotation;
+  };
+
+public:
+  MotionToleranceCallback(simplebal::BALManager& _balManager, 
+                          double _point_tolerance, double _translation_tolerance, double _rotation_tolerance)
+  : balManager(_balManager),
+    point_tolerance(_point_tolerance), translation_tolerance(_translation_tolerance), rotation_tolerance(_rotation_tolerance),
+    previous_rotations(3*_balManager.num_cameras()), previous_centers(3*_balManager.num_cameras()), 
+    previous_points(3*_balManager.num_points())
+  {
+    computeMotion(); // the initial state
+  }
+
+  virtual ~MotionToleranceCallback() {}
+
+  ceres::CallbackReturnType operator()(const ceres::IterationSummary& summary) final {
+    // the state does not change on a rejected step (and there is no step at iteration 0)
+    if (summary.iteration == 0 || !summary.step_is_successful)
+      return ceres::SOLVER_CONTINUE;
+
+    const Motion motion = computeMotion();
+    motions.push_back(motion);
+
+    // the distances are measured in the input frame, even if the BALManager is normalized
+    const bool points_converged = (motion.max_point < point_tolerance);
+    const bool translations_converged = (translation_tolerance <= 0.0) || (motion.max_translation < translation_tolerance);
+    const bool rotations_converged = (rotation_tolerance <= 0.0) || (motion.max_rotation < rotation_tolerance);
+    if (points_converged && translations_converged && rotations_converged) {
+      cout << "     landmark motion (max " << motion.max_point << ", rms " << motion.rms_point 
+           << ") is below the tolerance, terminating at iteration " << summary.iteration << endl;
+      stopped_iteration = summary.iteration;
+      return ceres::SOLVER_TERMINATE_SUCCESSFULLY;
+    }
+    return ceres::SOLVER_CONTINUE;
+  }
+
+  // the motion since the previous call, in the input frame
+  Motion computeMotion() {
+    Motion motion {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    const double* scene_center = balManager.sceneCenter();
+    const double inverse_scale = 1.0 / balManager.sceneScale();
+    const double* cameras = balManager.mutable_cameras();
+    const double* points = cameras + 9*balManager.num_cameras();
+
+    for (int i = 0; i < balManager.num_cameras(); ++i) {
+      const double* camera = cameras + 9*i;
+      double center[3];
+      balManager.cameraToCenter(camera, center);
+      double rotation = 0.0, translation = 0.0;
+      for (int k = 0; k < 3; ++k) {
+        center[k] = center[k] * inverse_scale + scene_center[k];
+        rotation += (camera[k] - previous_rotations[3*i + k]) * (camera[k] - previous_rotations[3*i + k]);
+        translation += (center[k] - previous_centers[3*i + k]) * (center[k] - previous_centers[3*i + k]);
+        previous_rotations[3*i + k] = camera[k];
+        previous_centers[3*i + k] = center[k];
+      }
+      motion.max_rotation = std::max(motion.max_rotation, rotation);
+      motion.rms_rotation += rotation;
+      motion.max_translation = std::max(motion.max_translation, translation);
+      motion.rms_translation += translation;
+    }
+
+    for (int i = 0; i < balManager.num_points(); ++i) {
+      double displacement = 0.0;
+      for (int k = 0; k < 3; ++k) {
+        const double point = points[3*i + k] * inverse_scale + scene_center[k];
+        displacement += (point - previous_points[3*i + k]) * (point - previous_points[3*i + k]);
+        previous_points[3*i + k] = point;
+      }
+      motion.max_point = std::max(motion.max_point, displacement);
+      motion.rms_point += displacement;
+    }
+
+    // squared sums to the max / rms distances
+    const double num_cameras = std::max(1, balManager.num_cameras());
+    const double num_points = std::max(1, balManager.num_points());
+    motion.max_rotation = std::sqrt(motion.max_rotation);
+    motion.rms_rotation = std::sqrt(motion.rms_rotation / num_cameras);
+    motion.max_translation = std::sqrt(motion.max_translation);
+    motion.rms_translation = std::sqrt(motion.rms_translation / num_cameras);
+    motion.max_point = std::sqrt(motion.max_point);
+    motion.rms_point = std::sqrt(motion.rms_point / num_points);
+    return motion;
+  }
+
+public:
+  simplebal::BALManager& balManager;
+  const double point_tolerance;
+  const double translation_tolerance;
+  const double rotation_tolerance;
+  std::vector<double> previous_rotations; // the angle-axis vectors
+  std::vector<double> previous_centers;   // the camera centers in the input frame
+  std::vector<double> previous_points;    // the landmarks in the input frame
+  std::vector<Motion> motions; // one per successful step
+  int stopped_iteration {-1};  // -1 if the solve ended by itself
+};
+
 } // namespace simplebal
 
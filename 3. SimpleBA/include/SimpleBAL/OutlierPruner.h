@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "ceres/ceres.h"
+#include "ceres/loss_function.h"
+
+#include "Profiling/ResidualProfiler.h"
+
+#include "SimpleBAL/BALManager.h"
+#include "SimpleBAL/OptionConfig.h"
+#include "SimpleBAL/Residual.h"
+
+namespace simplebal {
+
+struct PruningRoundStats {
+  int round;
+  bool robust;
+  int num_residual_blocks;
+  int num_parameter_blocks;
+  int num_pruned_observations; // pruned after this round
+  int num_iterations;
+  double time_in_seconds;      // problem construction + solve + scoring
+  double rms_error;            // over the observations used in this round, in pixels
+};
+
+// Multi-round solver that shrinks the BA problem between the rounds.
+//  - round 1 : a short solve with a robust (Cauchy) loss, so that the gross outliers do not drag the solution.
+//  - then    : every observation is scored by its reprojection error (in parallel), the bad ones are dropped,
+//              and the points left with less than two observations are dropped as well.
+//  - round 2~: the smaller problem is rebuilt (the loss of a residual block cannot be changed in place) and solved with the squared loss.
+class OutlierPruner {
+public:
+  explicit OutlierPruner(BALManager& _balManager);
+
+  // With a _profiler, every cost function is wrapped by it (see Profiling/ResidualProfiler.h).
+  void buildProblem(ceres::Problem& _problem, bool _robust, profiling::ResidualProfiler* _profiler = nullptr) const;
+  void scoreObservations(int _num_threads);
+  int pruneObservations(double _threshold);
+  double rmsError() const;
+
+  std::vector<PruningRoundStats> run(const ceres::Solver::Options& _options, profiling::ResidualProfiler* _profiler = nullptr);
+
+  bool isInlier(int i) const { return is_inlier_[i] != 0; }
+  int num_inliers() const { return static_cast<int>(std::count(is_inlier_.begin(), is_inlier_.end(), 1)); }
+  double error(int i) const { return errors_[i]; }
+
+private:
+  BALManager& balManager_;
+  std::vector<char> is_inlier_; // not vector<bool>, so that the scoring threads can write disjoint entries
+  std::vector<double> errors_;  // reprojection error of each observation, in pixels
+};
+
+} // namespace simplebal
+
+
+simplebal::OutlierPruner::OutlierPruner(BALManager& _balManager)
+: balManager_(_balManager),
+  is_inlier_(_balManager.num_observations(), 1),
+  errors_(_balManager.num_observations(), 0.0)
+{
+} // OutlierPruner
+
+void simplebal::OutlierPruner::buildProblem(ceres::Problem& _problem, bool _robust, profiling::ResidualProfiler* _profiler) const {
+  const double* observations = balManager_.observations();
+  for (int i = 0; i < balManager_.num_observations(); ++i) {
+    if (!isInlier(i))
+      continue;
+
+    auto cost_function = simplebal::genSnavelyReprojectionError(observations[2*i + 0], observations[2*i + 1]);
+    if (_profiler != nullptr)
+      cost_function = _profiler->wrap(cost_function, "SnavelyReprojectionError");
+    ceres::LossFunction* loss_function = _robust ? new ceres::CauchyLoss(FLAGS_robust_loss_scale / balManager_.observationScale()) : NULL;
+    _problem.AddResidualBlock(cost_function,
+                              loss_function,
+                              balManager_.mutable_camera_for_observation(i),
+                              balManager_.mutable_point_for_observation(i));
+  }
+} // buildProblem
+
+void simplebal::OutlierPruner::scoreObservations(int _num_threads) {
+  const int num_observations = balManager_.num_observations();
+  const int num_threads = std::max(1, std::min(_num_threads, num_observations));
+  const double* observations = balManager_.observations();
+  const double pixel_scale = balManager_.observationScale(); // the errors are kept in the input pixels even if the observations are normalized
+
+  // the parameters are only read here, so each thread scores its own contiguous chunk without any locking.
+  auto scoreChunk = [&](int _begin, int _end) {
+    for (int i = _begin; i < _end; ++i) {
+      SnavelyReprojectionError reprojection(observations[2*i + 0], observations[2*i + 1]);
+      double residuals[2];
+      reprojection(balManager_.mutable_camera_for_observation(i),
+                   balManager_.mutable_point_for_observation(i),
+                   residuals);
+      errors_[i] = pixel_scale * std::sqrt(residuals[0]*residuals[0] + residuals[1]*residuals[1]);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  const int chunk = (num_observations + num_threads - 1) / num_threads;
+  for (int t = 1; t < num_threads; ++t) {
+    workers.emplace_back(scoreChunk, std::min(t*chunk, num_observations), std::min((t+1)*chunk, num_observations));
+  }
+  scoreChunk(0, std::min(chunk, num_observations));
+  for (auto& worker: workers)
+    worker.join();
+} // scoreObservations
+
+int simplebal::OutlierPruner::pruneObservations(double _threshold) {
+  int num_pruned = 0;
+  for (int i = 0; i < balManager_.num_observations(); ++i) {
+    if (isInlier(i) && !(errors_[i] <= _threshold)) { // the negated form also catches NaN
+      is_inlier_[i] = 0;
+      num_pruned++;
+    }
+  }
+
+  // a point seen by less than two cameras is not triangulated anymore, so drop its remaining observation as well.
+  std::vector<int> num_point_observations(balManager_.num_points(), 0);
+  for (int i = 0; i < balManager_.num_observations(); ++i) {
+    if (isInlier(i))
+      num_point_observations[balManager_.point_index(i)]++;
+  }
+  for (int i = 0; i < balManager_.num_observations(); ++i) {
+    if (isInlier(i) && num_point_observations[balManager_.point_index(i)] < 2) {
+      is_inlier_[i] = 0;
+      num_pruned++;
+    }
+  }
+
+  return num_pruned;
+} // pruneObservations
+
+double simplebal::OutlierPruner::rmsError() const {
+  double sum_squared_error = 0.0;
+  int num_used = 0;
+  for (int i = 0; i < balManager_.num_observations(); ++i) {
+    if (isInlier(i)) {
+      sum_squared_error += errors_[i] * errors_[i];
+      num_used++;
+    }
+  }
+  return (num_used > 0) ? std::sqrt(sum_squared_error / num_used) : 0.0;
+} // rmsError
+
+std::vector<simplebal::PruningRoundStats> simplebal::OutlierPruner::run(const ceres::Solver::Options& _options,
+                                                                        profiling::ResidualProfiler* _profiler) {
+  std::vector<PruningRoundStats> stats;
+  const int num_rounds = std::max(1, FLAGS_pruning_rounds);
+
+  for (int round = 0; round < num_rounds; ++round) {
+    const auto start = std::chrono::steady_clock::now();
+
+    PruningRoundStats round_stats;
+    round_stats.round = round + 1;
+    round_stats.robust = (round == 0) && (num_rounds > 1);
+
+    ceres::Problem problem;
+    buildProblem(problem, round_stats.robust, _profiler);
+    round_stats.num_residual_blocks = problem.NumResidualBlocks();
+    round_stats.num_parameter_blocks = problem.NumParameterBlocks();
+
+    ceres::Solver::Options options = _options;
+    if (round_stats.robust)
+      options.max_num_iterations = FLAGS_robust_round_iterations;
+
+    ceres::Solver::Summary summary;
+    ceres::Solve(options, &problem, &summary);
+    round_stats.num_iterations = static_cast<int>(summary.iterations.size());
+
+    scoreObservations(_options.num_threads);
+    round_stats.rms_error = rmsError();
+    round_stats.num_pruned_observations = (round + 1 < num_rounds) ? pruneObservations(FLAGS_outlier_threshold) : 0;
+
+    round_stats.time_in_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.push_back(round_stats);
+
+    cout << "round " << round_stats.round << (round_stats.robust ? " (robust)" : " (squared)")
+         << " - residual blocks: " << round_stats.num_residual_blocks
+         << ", parameter blocks: " << round_stats.num_parameter_blocks
+         << ", iterations: " << round_stats.num_iterations
+         << ", time: " << round_stats.time_in_seconds << " sec"
+         << ", rms error: " << round_stats.rms_error << " px"
+         << ", pruned: " << round_stats.num_pruned_observations << endl;
+  }
+
+  return stats;
+} // run
@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <iostream>
+#include <memory>
 #include <sstream>
 
 #include "ceres/ceres.h"
@@ -9,27 +11,267 @@
 #include "SimpleBAL/OptionConfig.h"
 #include "SimpleBAL/BALManager.h"
 #include "SimpleBAL/Residual.h"
+#include "SimpleBAL/OutlierPruner.h"
+#include "SimpleBAL/CovarianceEstimator.h"
+#include "SimpleBAL/Checkpoint.h"
+#include "SimpleBAL/IncrementalBA.h"
+#include "SimpleBAL/MiniBatch.h"
+#include "SimpleBAL/MemoryReport.h"
+
+#include "Profiling/ResidualProfiler.h"
+
+// post-solve uncertainty for the downstream fusion (see --covariance_file), false if it was requested but failed
+bool writeCovariances(simplebal::BALManager& _bal, const simplebal::OutlierPruner* _pruner)
+{
+  if (FLAGS_covariance_file.empty())
+    return true;
+
+  simplebal::CovarianceEstimator estimator(_bal);
+  estimator.selectPoints(FLAGS_covariance_point_stride);
+  if (!estimator.compute(FLAGS_num_threads, _pruner) || !estimator.writeBinary(FLAGS_covariance_file)) {
+    std::cerr << "ERROR: unable to compute or write the covariances to " << FLAGS_covariance_file << "\n";
+    return false;
+  }
+  std::cout << "covariances of " << estimator.num_camera_covariances() << " cameras and "
+            << estimator.num_point_covariances() << " points saved to " << FLAGS_covariance_file << "\n";
+  return true;
+}
+
+
+// the input file, or the synthetic scene of --synthetic_cameras
+bool loadInput(simplebal::BALManager& _bal, const char* _filename, std::string* _error = nullptr)
+{
+  if (FLAGS_synthetic_cameras > 0) {
+    _bal.generateSynthetic(FLAGS_synthetic_cameras, FLAGS_synthetic_points, FLAGS_synthetic_observations_per_point,
+                           FLAGS_synthetic_offset, FLAGS_synthetic_scale, 0);
+    return true;
+  }
+  return _bal.loadFile(_filename, _error);
+}
+
+// one plain solve of a freshly loaded input, raw or normalized (see --compare_normalization),
+// and optionally terminated by the landmark motion (see --compare_motion_tolerance)
+ceres::Solver::Summary solveForComparison(const char* _filename, bool _normalize, bool _motion_tolerance)
+{
+  simplebal::BALManager bal;
+  ceres::Solver::Summary summary;
+  if (!loadInput(bal, _filename))
+    return summary;
+  if (_normalize)
+    bal.normalize(FLAGS_normalize_cameras);
+
+  ceres::Problem problem;
+  const double* observations = bal.observations();
+  for (int i = 0; i < bal.num_observations(); ++i) {
+    problem.AddResidualBlock(simplebal::genSnavelyReprojectionError(observations[2*i + 0], observations[2*i + 1]),
+                             NULL,
+                             bal.mutable_camera_for_observation(i),
+                             bal.mutable_point_for_observation(i));
+  }
+
+  ceres::Solver::Options options;
+  simplebal::setSolverOptions(options);
+  options.minimizer_progress_to_stdout = false;
+  std::unique_ptr<simplebal::MotionToleranceCallback> motion_callback;
+  if (_motion_tolerance) {
+    motion_callback.reset(new simplebal::MotionToleranceCallback(bal, FLAGS_point_motion_tolerance,
+                                                                 FLAGS_translation_motion_tolerance, FLAGS_rotation_motion_tolerance));
+    options.update_state_every_iteration = true;
+    options.callbacks.push_back(motion_callback.get());
+  }
+  ceres::Solve(options, &problem, &summary);
+
+  // the costs of a normalized run are in units of the observation scale
+  summary.initial_cost *= bal.observationScale() * bal.observationScale();
+  summary.final_cost *= bal.observationScale() * bal.observationScale();
+  return summary;
+}
 
 
 int main(int argc, char** argv) 
 {
   // prepare the data from here: http://grail.cs.washington.edu/projects/bal/ladybug.html (homepage: http://grail.cs.washington.edu/projects/bal/)
   google::InitGoogleLogging(argv[0]);
-  if (argc != 2) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  if (argc != 2 && !(argc == 1 && FLAGS_synthetic_cameras > 0)) {
     std::cerr << "how to use: e.g., $ ./build/main data/problem-49-7776-pre.txt\n"; 
+    std::cerr << "            or,   $ ./build/main --pruning_rounds=3 --outlier_threshold=4.0 data/problem-49-7776-pre.txt\n"; 
+    std::cerr << "            or,   $ ./build/main --synthetic_cameras=50 --compare_normalization\n"; 
     return 1;
   }
+  const char* input = (argc == 2) ? argv[1] : "/tmp/synthetic";
+
+  // the checkpoints (and the low memory options) only apply to the default solve
+  const bool alternative_mode = FLAGS_compare_normalization || FLAGS_compare_motion_tolerance || FLAGS_incremental_batch_size > 0
+                             || FLAGS_minibatch_initial_fraction > 0.0 || FLAGS_pruning_rounds > 1;
+  if (alternative_mode && (!FLAGS_checkpoint_file.empty() || FLAGS_resume)) {
+    std::cerr << "ERROR: --checkpoint_file and --resume only apply to the default solve, "
+              << "not to the incremental, mini-batch, pruning or comparison modes\n";
+    return 1;
+  }
+  if (alternative_mode && (FLAGS_low_memory || FLAGS_low_memory_solver)) {
+    std::cerr << "ERROR: --low_memory and --low_memory_solver only apply to the default solve, "
+              << "not to the incremental, mini-batch, pruning or comparison modes\n";
+    return 1;
+  }
+
+  // the same problem, raw and normalized
+  if (FLAGS_compare_normalization) {
+    for (int normalized = 0; normalized < 2; ++normalized) {
+      const ceres::Solver::Summary summary = solveForComparison(input, normalized, false);
+      printf("%-10s: %3d iterations, %8.3f sec, cost %.6e -> %.6e (%s)\n", normalized ? "normalized" : "raw", 
+             static_cast<int>(summary.iterations.size()), summary.total_time_in_seconds, 
+             summary.initial_cost, summary.final_cost, summary.IsSolutionUsable() ? "usable" : "failed");
+    }
+    return 0;
+  }
+
+  // the same problem, with the default termination and with the landmark motion one
+  if (FLAGS_compare_motion_tolerance) {
+    if (FLAGS_point_motion_tolerance <= 0.0) {
+      std::cerr << "ERROR: --compare_motion_tolerance needs --point_motion_tolerance > 0\n";
+      return 1;
+    }
+    for (int with_tolerance = 0; with_tolerance < 2; ++with_tolerance) {
+      const ceres::Solver::Summary summary = solveForComparison(input, FLAGS_normalize, with_tolerance);
+      printf("%-10s: %3d iterations, %8.3f sec, cost %.6e -> %.6e (%s)\n", with_tolerance ? "motion" : "default", 
+             static_cast<int>(summary.iterations.size()), summary.total_time_in_seconds, 
+             summary.initial_cost, summary.final_cost, summary.IsSolutionUsable() ? "usable" : "failed");
+    }
+    return 0;
+  }
+
+  if (FLAGS_low_memory && !FLAGS_covariance_file.empty()) {
+    std::cerr << "ERROR: --low_memory frees the observations, which --covariance_file needs\n";
+    return 1;
+  }
+
+  std::unique_ptr<simplebal::MemoryReport> memory_report;
+  if (FLAGS_memory_report)
+    memory_report.reset(new simplebal::MemoryReport);
 
   // about the BAL details, see the Bundle Adjustment in the Large paper (ECCV 2010, http://grail.cs.washington.edu/projects/bal/bal.pdf)
   simplebal::BALManager bal;
-  if (!bal.loadFile(argv[1])) {
-    std::cerr << "ERROR: unable to open file " << argv[1] << "\n";
+  std::string load_error;
+  if (!loadInput(bal, input, &load_error)) {
+    std::cerr << "ERROR: " << load_error << "\n";
     return 1;
   }
+  const simplebal::BALManager::MemoryUsage loaded_memory = bal.memoryUsage();
+  if (memory_report)
+    memory_report->mark("load");
+
+  if (FLAGS_normalize)
+    bal.normalize(FLAGS_normalize_cameras);
 
-  std::stringstream ss; ss << argv[1] <<  ".result.txt";
+  std::stringstream ss; ss << input <<  ".result.txt";
   std::string resultFilePath = ss.str();
   bal.writeResultFile(resultFilePath);
+
+  // --profile_residuals wraps the cost functions of every mode below; the baseline of a mode gets its own profiler
+  profiling::ResidualProfiler profiler(FLAGS_profile_top_k), baseline_profiler(FLAGS_profile_top_k);
+  profiling::ResidualProfiler* const profiled = FLAGS_profile_residuals ? &profiler : nullptr;
+  profiling::ResidualProfiler* const profiled_baseline = FLAGS_profile_residuals ? &baseline_profiler : nullptr;
+
+  // incremental mode: the cameras arrive in batches, each followed by a local BA (and a periodic global BA).
+  if (FLAGS_incremental_batch_size > 0) {
+    ceres::Solver::Options options;
+    simplebal::setSolverOptions(options);
+
+    // the baseline starts from the same input values, so it runs on a copy of them
+    std::vector<double> initial_parameters(bal.mutable_cameras(), bal.mutable_cameras() + bal.num_parameters());
+    double full_time = 0.0;
+    if (FLAGS_incremental_compare_full) {
+      full_time = simplebal::replayIncrementally(bal, options, FLAGS_incremental_batch_size, 1, false, profiled_baseline);
+      std::copy(initial_parameters.begin(), initial_parameters.end(), bal.mutable_cameras());
+    }
+
+    const double incremental_time = simplebal::replayIncrementally(bal, options, FLAGS_incremental_batch_size, FLAGS_incremental_global_every,
+                                                                   true, profiled);
+    std::cout << "\nIncremental BA - cumulative time: " << incremental_time << " sec";
+    if (FLAGS_incremental_compare_full)
+      std::cout << " (vs. " << full_time << " sec for a full re-solve after every batch)";
+    std::cout << "\n";
+    if (FLAGS_profile_residuals) {
+      if (FLAGS_incremental_compare_full) {
+        std::cout << "\n[full re-solve after every batch]";
+        baseline_profiler.report(std::cout);
+        std::cout << "\n[incremental]";
+      }
+      profiler.report(std::cout);
+    }
+
+    bal.denormalize();
+    bal.writeResultFile();
+    return writeCovariances(bal, nullptr) ? 0 : 1;
+  }
+
+  // mini-batch mode: the first phases on growing random subsets of the observations, the final phase on the full problem.
+  if (FLAGS_minibatch_initial_fraction > 0.0) {
+    ceres::Solver::Options options;
+    simplebal::setSolverOptions(options);
+
+    simplebal::MiniBatchOptions minibatch_options;
+    minibatch_options.initial_fraction = FLAGS_minibatch_initial_fraction;
+    minibatch_options.growth = FLAGS_minibatch_growth;
+    minibatch_options.phase_max_iterations = FLAGS_minibatch_phase_iterations;
+
+    // the full-batch baseline (a single final phase) from the same initial values
+    const std::vector<double> initial_parameters(bal.parameters(), bal.parameters() + bal.num_parameters());
+    simplebal::MiniBatchOptions full_batch_options;
+    full_batch_options.initial_fraction = 1.0;
+    ceres::Solver::Summary full_batch_summary;
+    const simplebal::MiniBatchPhaseStats full_batch = 
+        simplebal::solveWithMiniBatches(bal, options, full_batch_options, &full_batch_summary, profiled_baseline).back();
+    std::copy(initial_parameters.begin(), initial_parameters.end(), bal.mutable_cameras());
+
+    ceres::Solver::Summary final_summary;
+    auto stats = simplebal::solveWithMiniBatches(bal, options, minibatch_options, &final_summary, profiled);
+
+    double total_time = 0.0, warm_time = 0.0;
+    for (auto& _phase: stats)
+      total_time += _phase.time_in_seconds;
+    warm_time = total_time - stats.back().time_in_seconds;
+    std::cout << "\nMini-batch summary: final cost " << stats.back().final_cost << ", total time: " << total_time << " sec"
+              << " (vs. final cost " << full_batch.final_cost << ", " << full_batch.time_in_seconds << " sec for the full-batch solve)\n";
+
+    // the time of both to reach the same cost, the worse of the two final costs
+    const double common_cost = std::max(full_batch.final_cost, stats.back().final_cost) * (1.0 + 1e-6);
+    std::cout << "Time to reach the cost " << common_cost << ": full batch " << simplebal::timeToCost(full_batch_summary, common_cost)
+              << " sec, mini-batch " << warm_time + simplebal::timeToCost(final_summary, common_cost) << " sec (the warm phases included)\n";
+    if (FLAGS_profile_residuals) {
+      std::cout << "\n[full batch]";
+      baseline_profiler.report(std::cout);
+      std::cout << "\n[mini-batch]";
+      profiler.report(std::cout);
+    }
+
+    bal.denormalize();
+    bal.writeResultFile();
+    return writeCovariances(bal, nullptr) ? 0 : 1;
+  }
+
+  // multi-round mode: a short robust solve, then prune the outliers and re-solve the smaller problem with the squared loss.
+  if (FLAGS_pruning_rounds > 1) {
+    ceres::Solver::Options options;
+    simplebal::setSolverOptions(options);
+
+    simplebal::OutlierPruner pruner(bal);
+    auto stats = pruner.run(options, profiled);
+
+    double total_time = 0.0;
+    for (auto& _round: stats)
+      total_time += _round.time_in_seconds;
+    std::cout << "\nPruning summary: " << pruner.num_inliers() << " / " << bal.num_observations() << " observations kept"
+              << ", final rms error: " << stats.back().rms_error << " px"
+              << ", total time: " << total_time << " sec\n";
+    if (FLAGS_profile_residuals)
+      profiler.report(std::cout);
+
+    bal.denormalize();
+    bal.writeResultFile();
+    return writeCovariances(bal, &pruner) ? 0 : 1;
+  }
   
   // Create residuals for each observation in the bundle adjustment problem. The parameters for cameras and points are added automatically.
   ceres::Problem problem;
@@ -38,12 +280,18 @@ int main(int argc, char** argv)
     // Each Residual block takes a point and a camera as input and outputs a 2
     // dimensional residual. Internally, the cost function stores the observed
     // image location and compares the reprojection against the observation.
-    auto cost_function = simplebal::genSnavelyReprojectionError(observations[2*i + 0], observations[2*i + 1]);
+    ceres::CostFunction* cost_function = simplebal::genSnavelyReprojectionError(observations[2*i + 0], observations[2*i + 1]);
+    if (profiled != nullptr)
+      cost_function = profiled->wrap(cost_function, "SnavelyReprojectionError");
     problem.AddResidualBlock(cost_function,
                              NULL, /* squared loss or use robust loss: "new ceres::CauchyLoss(0.5)", note but robust kernel would delay the convergence */
                              bal.mutable_camera_for_observation(i),
                              bal.mutable_point_for_observation(i));
   }
+  if (FLAGS_low_memory)
+    bal.releaseObservations();
+  if (memory_report)
+    memory_report->mark("construction");
 
   // Make Ceres automatically detect the bundle structure. Note that the
   // standard solver, SPARSE_NORMAL_CHOLESKY, also works fine but it is slower
@@ -52,14 +300,57 @@ int main(int argc, char** argv)
 
   ceres::Solver::Options options;
   simplebal::setSolverOptions(options);
+  if (FLAGS_low_memory_solver) {
+    options.linear_solver_type = ceres::ITERATIVE_SCHUR;
+    options.preconditioner_type = ceres::SCHUR_JACOBI;
+  }
+
+  // continue a preempted job from its last checkpoint, with the trust region it had at that time
+  simplebal::CheckpointHeader checkpoint;
+  if (FLAGS_resume) {
+    if (!simplebal::loadCheckpoint(FLAGS_checkpoint_file, bal, &checkpoint)) {
+      std::cerr << "ERROR: unable to resume from " << FLAGS_checkpoint_file << "\n";
+      return 1;
+    }
+    options.initial_trust_region_radius = checkpoint.trust_region_radius;
+    options.max_num_iterations = std::max(0, options.max_num_iterations - checkpoint.iteration);
+    std::cout << "resumed from the checkpoint at iteration " << checkpoint.iteration << "\n";
+  }
 
   options.update_state_every_iteration = true;
-  simplebal::WritingMidResultsCallback my_callback(bal);
+  simplebal::WritingMidResultsCallback my_callback(bal, checkpoint.iteration);
   options.callbacks.push_back(&my_callback);
 
+  std::unique_ptr<simplebal::MotionToleranceCallback> motion_callback;
+  if (FLAGS_point_motion_tolerance > 0.0) {
+    motion_callback.reset(new simplebal::MotionToleranceCallback(bal, FLAGS_point_motion_tolerance, 
+                                                                 FLAGS_translation_motion_tolerance, FLAGS_rotation_motion_tolerance));
+    options.callbacks.push_back(motion_callback.get());
+  }
+
+  if (memory_report)
+    options.callbacks.push_back(memory_report.get());
+
+  std::unique_ptr<simplebal::CheckpointCallback> checkpoint_callback;
+  if (!FLAGS_checkpoint_file.empty()) {
+    checkpoint_callback.reset(new simplebal::CheckpointCallback(bal, FLAGS_checkpoint_file, FLAGS_checkpoint_every, checkpoint.iteration));
+    options.callbacks.push_back(checkpoint_callback.get());
+  }
+
   ceres::Solve(options, &problem, &summary);
+  checkpoint_callback.reset(); // flush the last checkpoint before the parameters are mapped back
+  if (memory_report) {
+    memory_report->mark("solve");
+    memory_report->print(bal, problem.NumResidualBlocks(), loaded_memory, profiled != nullptr && profiling::ResidualProfiler::enabled());
+  }
+  bal.denormalize();
 
   std::cout << summary.FullReport() << "\n";
+  if (FLAGS_profile_residuals)
+    profiler.report(std::cout);
+  std::cout << "normalize: " << (FLAGS_normalize ? (FLAGS_normalize_cameras ? "scene+cameras" : "scene") : "off")
+            << ", iterations: " << summary.iterations.size()
+            << ", total time: " << summary.total_time_in_seconds << " sec\n";
 
-  return 0;
+  return writeCovariances(bal, nullptr) ? 0 : 1;
 }
\ No newline at end of file
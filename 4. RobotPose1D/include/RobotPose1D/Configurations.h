@@ -35,6 +35,26 @@ DEFINE_double(range_stddev,
               0.01,
               "The standard deviation of range readings of the robot.");
 
+DEFINE_bool(specialized_range_constraint,
+            true,
+            "Use the statically sized RangeConstraint cost functions when "
+            "the number of poses fits, instead of always the dynamic one.");
+
+DEFINE_bool(profile_residuals,
+            false,
+            "Wrap every cost function with the evaluation profiler, and print its report after the solve "
+            "(needs the ENABLE_RESIDUAL_PROFILER build option).");
+
+DEFINE_int32(profile_top_k,
+             10,
+             "The number of the slowest residual blocks in the profiler report.");
+
+DEFINE_int32(repeated_solves,
+             0,
+             "If positive, solve the simulated problem this many times with new readings, "
+             "on a problem built once (RepeatedSolver.h) and on a problem rebuilt for each solve, "
+             "and print the per-solve latency of both.");
+
 
 namespace rp1 {
 
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "RobotPose1D/Configurations.h"
+#include "RobotPose1D/Residuals.h"
+
+namespace rp1 { // robot-pose-1d
+
+// Repeated solves of a fixed-structure problem (a control loop: the same number of poses, new readings each time).
+// The problem is built once: the cost functions read the odometry and range readings from the buffers of this class
+// (see BufferedOdometryConstraint and BufferedRangeConstraint), so new readings are written in place, and the next Solve()
+// skips the construction of the cost functions and of the problem. That is all it saves: ceres::Solve() still validates
+// the options, runs its preprocessor and the analysis of the linear solver, and allocates its workspace on each call,
+// there is no public API to keep them. The range constraints make the normal equations dense (each one touches all
+// the previous poses), thus the dense normal Cholesky at least has no ordering to compute.
+class RepeatedSolver 
+{
+public: 
+  RepeatedSolver(int num_poses, const ceres::Solver::Options& options);
+
+  int num_poses() const { return static_cast<int>(odometry_values.size()); }
+
+  // the shared buffers read by the cost functions, write the new readings there before Solve()
+  double* mutable_odometry_readings() { return odometry_readings.data(); }
+  double* mutable_range_readings() { return range_readings.data(); }
+
+  // the estimates of the last solve
+  const std::vector<double>& estimates() const { return odometry_values; }
+
+  // With warm_start, the estimates of the previous solve are the initial values, otherwise the odometry readings.
+  void Solve(bool warm_start, ceres::Solver::Summary* summary);
+
+private: 
+  std::vector<double> odometry_readings;
+  std::vector<double> range_readings;
+  std::vector<double> odometry_values; // the parameter blocks, never resized (the problem holds their addresses)
+
+  ceres::Problem problem;
+  ceres::Solver::Options solver_options;
+}; // RepeatedSolver
+
+} // namespace rp1
+
+
+rp1::RepeatedSolver::RepeatedSolver(int num_poses, const ceres::Solver::Options& options)
+    : odometry_readings(num_poses, CERES_GET_FLAG(FLAGS_pose_separation)),
+      range_readings(num_poses, 0.0),
+      odometry_values(num_poses, CERES_GET_FLAG(FLAGS_pose_separation)),
+      solver_options(options) 
+{
+  for (int i = 0; i < num_poses; ++i) {
+    std::vector<double*> parameter_blocks;
+    problem.AddResidualBlock(BufferedRangeConstraint::CreateSpecialized(i, &range_readings[i], &odometry_values, &parameter_blocks),
+                             NULL, parameter_blocks);
+    problem.AddResidualBlock(BufferedOdometryConstraint::Create(&odometry_readings[i]), 
+                             NULL, &odometry_values[i]);
+  }
+
+  std::string error;
+  CHECK(solver_options.IsValid(&error)) << error; // fail early, ceres::Solve() validates them again at each call
+} // RepeatedSolver
+
+void rp1::RepeatedSolver::Solve(bool warm_start, ceres::Solver::Summary* summary) 
+{
+  if (!warm_start)
+    std::copy(odometry_readings.begin(), odometry_readings.end(), odometry_values.begin()); // in place, the problem holds the addresses
+  ceres::Solve(solver_options, &problem, summary);
+} // Solve
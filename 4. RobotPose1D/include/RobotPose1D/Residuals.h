@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+
 #include "RobotPose1D/Configurations.h"
 
 namespace rp1 { // robot-pose-1d
@@ -85,6 +87,15 @@ public:
     return (cost_function);
   }
 
+  // Same as Create, but dispatches to a statically sized cost function
+  // (see FixedRangeCostFunction) when the number of parameter blocks fits one
+  // of the compile-time sizes. Only the genuinely large cases fall back to
+  // the DynamicAutoDiffCostFunction, with a stride tuned to their size.
+  static ceres::CostFunction* CreateSpecialized(const int pose_index,
+                                                const double range_reading,
+                                                std::vector<double>* odometry_values,
+                                                std::vector<double*>* parameter_blocks);
+
 public: 
   const int pose_index;
   const double range_reading;
@@ -92,4 +103,190 @@ public:
   const double corridor_length;
 }; // RangeConstraint
 
+
+// As OdometryConstraint, but the reading stays in the caller's buffer and is
+// read at each evaluation, so a prepared problem can be solved again on new
+// readings (see RepeatedSolver.h).
+struct BufferedOdometryConstraint 
+{
+public: 
+  typedef ceres::AutoDiffCostFunction<BufferedOdometryConstraint, 1, 1> 
+      OdometryCostFunction;
+
+public: 
+  BufferedOdometryConstraint(const double* odometry_reading, double odometry_stddev)
+      : odometry_reading(odometry_reading), odometry_stddev(odometry_stddev) {}
+
+  template <typename T>
+  bool operator()(const T* const odometry, T* residual) const 
+  {
+    return OdometryConstraint(*odometry_reading, odometry_stddev)(odometry, residual);
+  }
+
+  static OdometryCostFunction* Create(const double* odometry_reading) 
+  {
+    return new OdometryCostFunction(new BufferedOdometryConstraint(
+        odometry_reading, CERES_GET_FLAG(FLAGS_odometry_stddev)));
+  }
+
+public: 
+  const double* const odometry_reading;
+  const double odometry_stddev;
+}; // BufferedOdometryConstraint
+
+
+// As RangeConstraint, but the reading stays in the caller's buffer and is
+// read at each evaluation (see RepeatedSolver.h).
+struct BufferedRangeConstraint 
+{
+public: 
+  BufferedRangeConstraint(int pose_index,
+                          const double* range_reading,
+                          double range_stddev,
+                          double corridor_length)
+      : pose_index(pose_index),
+        range_reading(range_reading),
+        range_stddev(range_stddev),
+        corridor_length(corridor_length) {}
+
+  template <typename T>
+  bool operator()(T const* const* relative_poses, T* residuals) const {
+    return RangeConstraint(pose_index, *range_reading, range_stddev, corridor_length)(relative_poses, residuals);
+  }
+
+  // Same dispatch as RangeConstraint::CreateSpecialized.
+  static ceres::CostFunction* CreateSpecialized(const int pose_index,
+                                                const double* range_reading,
+                                                std::vector<double>* odometry_values,
+                                                std::vector<double*>* parameter_blocks);
+
+public: 
+  const int pose_index;
+  const double* const range_reading;
+  const double range_stddev;
+  const double corridor_length;
+}; // BufferedRangeConstraint
+
+
+// A RangeConstraint whose derivatives are computed in one pass with
+// fixed-size jets: the odometry of all the (size 1) parameter blocks is packed
+// into one contiguous array of ceres::Jet<double, kMaxPoses>, instead of the
+// ceil(N / kStride) passes over the parameter list of the dynamic version.
+// The Constraint is RangeConstraint or BufferedRangeConstraint.
+template <int kMaxPoses, typename Constraint = RangeConstraint>
+class FixedRangeCostFunction : public ceres::CostFunction 
+{
+public: 
+  typedef ceres::Jet<double, kMaxPoses> JetT;
+
+public: 
+  explicit FixedRangeCostFunction(Constraint* constraint)
+      : constraint_(constraint) {
+    CHECK_LE(constraint->pose_index + 1, kMaxPoses);
+    mutable_parameter_block_sizes()->assign(constraint->pose_index + 1, 1);
+    set_num_residuals(1);
+  }
+
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const override {
+    if (jacobians == NULL) {
+      return (*constraint_)(parameters, residuals);
+    }
+
+    const int num_poses = constraint_->pose_index + 1;
+    JetT poses[kMaxPoses];
+    const JetT* pose_pointers[kMaxPoses];
+    for (int i = 0; i < num_poses; ++i) {
+      poses[i] = JetT(parameters[i][0], i);
+      pose_pointers[i] = &poses[i];
+    }
+
+    JetT residual;
+    if (!(*constraint_)(pose_pointers, &residual)) {
+      return false;
+    }
+
+    residuals[0] = residual.a;
+    for (int i = 0; i < num_poses; ++i) {
+      if (jacobians[i] != NULL) {
+        jacobians[i][0] = residual.v[i];
+      }
+    }
+    return true;
+  }
+
+private: 
+  std::unique_ptr<Constraint> constraint_;
+}; // FixedRangeCostFunction
+
+
+namespace internal {
+
+template <int kStride, typename Constraint>
+ceres::CostFunction* CreateDynamicRangeCostFunction(Constraint* constraint) 
+{
+  auto cost_function = new ceres::DynamicAutoDiffCostFunction<Constraint, kStride>(constraint);
+  for (int i = 0; i <= constraint->pose_index; ++i) {
+    cost_function->AddParameterBlock(1);
+  }
+  cost_function->SetNumResiduals(1);
+  return cost_function;
+}
+
+// The one dispatch of RangeConstraint::CreateSpecialized and BufferedRangeConstraint::CreateSpecialized:
+// fills the parameter blocks of the constraint, and picks the smallest compile-time size that fits,
+// so the padding of the jets stays small.
+template <typename Constraint>
+ceres::CostFunction* CreateSpecializedRangeCostFunction(Constraint* constraint,
+                                                        std::vector<double>* odometry_values,
+                                                        std::vector<double*>* parameter_blocks) 
+{
+  parameter_blocks->clear();
+  for (int i = 0; i <= constraint->pose_index; ++i) {
+    parameter_blocks->push_back(&((*odometry_values)[i]));
+  }
+
+  const int num_poses = constraint->pose_index + 1;
+  if (num_poses <= 4)  return new FixedRangeCostFunction<4, Constraint>(constraint);
+  if (num_poses <= 8)  return new FixedRangeCostFunction<8, Constraint>(constraint);
+  if (num_poses <= 16) return new FixedRangeCostFunction<16, Constraint>(constraint);
+  if (num_poses <= 32) return new FixedRangeCostFunction<32, Constraint>(constraint);
+  if (num_poses <= 64) return new FixedRangeCostFunction<64, Constraint>(constraint);
+
+  // genuinely large: a wider stride means fewer passes over the parameter list
+  if (num_poses <= 512) return CreateDynamicRangeCostFunction<32>(constraint);
+  return CreateDynamicRangeCostFunction<64>(constraint);
+}
+
+} // namespace internal
+
+
+ceres::CostFunction* RangeConstraint::CreateSpecialized(const int pose_index,
+                                                        const double range_reading,
+                                                        std::vector<double>* odometry_values,
+                                                        std::vector<double*>* parameter_blocks) 
+{
+  RangeConstraint* constraint =
+      new RangeConstraint(pose_index,
+                          range_reading,
+                          CERES_GET_FLAG(FLAGS_range_stddev),
+                          CERES_GET_FLAG(FLAGS_corridor_length));
+  return internal::CreateSpecializedRangeCostFunction(constraint, odometry_values, parameter_blocks);
+} // CreateSpecialized
+
+
+ceres::CostFunction* BufferedRangeConstraint::CreateSpecialized(const int pose_index,
+                                                                const double* range_reading,
+                                                                std::vector<double>* odometry_values,
+                                                                std::vector<double*>* parameter_blocks) 
+{
+  BufferedRangeConstraint* constraint =
+      new BufferedRangeConstraint(pose_index,
+                                  range_reading,
+                                  CERES_GET_FLAG(FLAGS_range_stddev),
+                                  CERES_GET_FLAG(FLAGS_corridor_length));
+  return internal::CreateSpecializedRangeCostFunction(constraint, odometry_values, parameter_blocks);
+} // CreateSpecialized
+
 } // namespace rp1
\ No newline at end of file
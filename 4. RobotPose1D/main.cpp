@@ -98,9 +98,14 @@
 // odoemtry observations will only be known at run time.
 
 
+#include <chrono>
+
 #include "RobotPose1D/Configurations.h"
 #include "RobotPose1D/Residuals.h"
 #include "RobotPose1D/Robot.h"
+#include "RobotPose1D/RepeatedSolver.h"
+
+#include "Profiling/ResidualProfiler.h"
 
 int main(int argc, char** argv) 
 {
@@ -113,6 +118,60 @@ int main(int argc, char** argv)
   CHECK_GT(CERES_GET_FLAG(FLAGS_odometry_stddev), 0.0);
   CHECK_GT(CERES_GET_FLAG(FLAGS_range_stddev), 0.0);
 
+  // repeated solves on new readings: the problem built once vs. rebuilt for each solve
+  if (CERES_GET_FLAG(FLAGS_repeated_solves) > 0) 
+  {
+    ceres::Solver::Options solver_options;
+    solver_options.linear_solver_type = ceres::DENSE_NORMAL_CHOLESKY;
+    solver_options.logging_type = ceres::SILENT;
+
+    std::vector<double> odometry_readings, range_readings;
+    rp1::SimulateRobot(&odometry_readings, &range_readings);
+    const int num_poses = static_cast<int>(odometry_readings.size());
+    rp1::RepeatedSolver repeated_solver(num_poses, solver_options);
+
+    double prepared_time = 0.0, prepared_preprocessor_time = 0.0;
+    double rebuilt_time = 0.0, rebuilt_preprocessor_time = 0.0;
+    for (int k = 0; k < CERES_GET_FLAG(FLAGS_repeated_solves); ++k) 
+    {
+      odometry_readings.clear();
+      range_readings.clear();
+      rp1::SimulateRobot(&odometry_readings, &range_readings);
+
+      // built once: the new readings are written into the shared buffers
+      auto start = std::chrono::steady_clock::now();
+      std::copy(odometry_readings.begin(), odometry_readings.end(), repeated_solver.mutable_odometry_readings());
+      std::copy(range_readings.begin(), range_readings.end(), repeated_solver.mutable_range_readings());
+      ceres::Solver::Summary summary;
+      repeated_solver.Solve(false, &summary);
+      prepared_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      prepared_preprocessor_time += summary.preprocessor_time_in_seconds;
+
+      // rebuilt for each solve, as in the single solve below
+      start = std::chrono::steady_clock::now();
+      std::vector<double> odometry_values = odometry_readings;
+      ceres::Problem problem;
+      for (int i = 0; i < num_poses; ++i) 
+      {
+        std::vector<double*> parameter_blocks;
+        problem.AddResidualBlock(rp1::RangeConstraint::CreateSpecialized(i, range_readings[i], &odometry_values, &parameter_blocks),
+                                 NULL, parameter_blocks);
+        problem.AddResidualBlock(rp1::OdometryConstraint::Create(odometry_readings[i]), NULL, &(odometry_values[i]));
+      }
+      ceres::Solve(solver_options, &problem, &summary);
+      rebuilt_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      rebuilt_preprocessor_time += summary.preprocessor_time_in_seconds;
+    }
+
+    const double num_solves = CERES_GET_FLAG(FLAGS_repeated_solves);
+    printf("%d poses, %d solves\n", num_poses, CERES_GET_FLAG(FLAGS_repeated_solves));
+    printf("  built once       : %9.1f us per solve (preprocessor %9.1f us)\n", 
+           1e6 * prepared_time / num_solves, 1e6 * prepared_preprocessor_time / num_solves);
+    printf("  rebuilt per solve: %9.1f us per solve (preprocessor %9.1f us)\n", 
+           1e6 * rebuilt_time / num_solves, 1e6 * rebuilt_preprocessor_time / num_solves);
+    return 0;
+  }
+
   // main 
   std::vector<double> odometry_values;
   std::vector<double> range_readings;
@@ -121,18 +180,28 @@ int main(int argc, char** argv)
   printf("Initial values:\n");
   rp1::PrintState(odometry_values, range_readings);
   ceres::Problem problem;
+  profiling::ResidualProfiler profiler(CERES_GET_FLAG(FLAGS_profile_top_k));
+  const bool profile = CERES_GET_FLAG(FLAGS_profile_residuals);
 
   for (int i = 0; i < odometry_values.size(); ++i) 
   {
     // Create and add a DynamicAutoDiffCostFunction for the RangeConstraint from pose i.
     std::vector<double*> parameter_blocks;
-    rp1::RangeConstraint::RangeCostFunction* range_cost_function =
-        rp1::RangeConstraint::Create(
-            i, range_readings[i], &odometry_values, &parameter_blocks);
+    ceres::CostFunction* range_cost_function =
+        CERES_GET_FLAG(FLAGS_specialized_range_constraint)
+            ? rp1::RangeConstraint::CreateSpecialized(
+                  i, range_readings[i], &odometry_values, &parameter_blocks)
+            : rp1::RangeConstraint::Create(
+                  i, range_readings[i], &odometry_values, &parameter_blocks);
+    if (profile)
+      range_cost_function = profiler.wrap(range_cost_function);
     problem.AddResidualBlock(range_cost_function, NULL, parameter_blocks);
 
     // Create and add an AutoDiffCostFunction for the OdometryConstraint for pose i.
-    problem.AddResidualBlock(rp1::OdometryConstraint::Create(odometry_values[i]),
+    ceres::CostFunction* odometry_cost_function = rp1::OdometryConstraint::Create(odometry_values[i]);
+    if (profile)
+      odometry_cost_function = profiler.wrap(odometry_cost_function, "OdometryConstraint");
+    problem.AddResidualBlock(odometry_cost_function,
                              NULL, // or new ceres::CauchyLoss(0.5)
                             //  new ceres::CauchyLoss(0.5),
                              &(odometry_values[i]));
@@ -150,6 +219,8 @@ int main(int argc, char** argv)
   printf("Done.\n");
 
   std::cout << summary.FullReport() << "\n";
+  if (profile)
+    profiler.report(std::cout);
   printf("Final values:\n");
 
   rp1::PrintState(odometry_values, range_readings);
@@ -0,0 +1,12 @@
+# how to use: 
+# $ sh build_and_run.sh
+
+mkdir build 
+cd build 
+cmake ..
+make 
+./server --socket_path=/tmp/ceres_solve_server.sock &
+SERVER_PID=$!
+sleep 1
+./loadgen --socket_path=/tmp/ceres_solve_server.sock --bal_file="../../3. SimpleBA/data/problem-49-7776-pre.txt"
+kill $SERVER_PID
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "ceres/ceres.h"
+
+#ifndef CERES_GET_FLAG
+#define CERES_GET_FLAG(X) X
+#endif
+
+DEFINE_string(socket_path, "/tmp/ceres_solve_server.sock",
+              "Path of the Unix domain socket the server listens on.");
+
+DEFINE_int32(pool_threads, std::max(1, static_cast<int>(std::thread::hardware_concurrency())), // 0 if it is unknown
+             "Number of threads shared by all the jobs. A job never starts before its thread budget is free.");
+
+DEFINE_int32(cache_size, 8,
+             "Number of loaded BAL problems kept in memory (least recently used ones are evicted).");
+
+DEFINE_int32(connection_threads, 4,
+             "Number of threads reading the requests of the accepted connections (the solves themselves run in the pool).");
+
+DEFINE_int32(max_pending_connections, 64,
+             "Accepted connections waiting for a reader thread. Once full, the new clients wait in the listen backlog.");
+
+DEFINE_int32(max_request_bytes, 16 << 20,
+             "Maximum size of a request line (a CURVE request carries its whole dataset). Longer requests are answered by an error.");
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace solveserver {
+
+// The accepted connections waiting for a reader thread, bounded so that a burst of clients can not spawn an unbounded
+// number of threads: once it is full, push() blocks the accept loop, and the new clients wait in the listen backlog of the socket.
+class ConnectionQueue {
+public:
+  explicit ConnectionQueue(int _capacity) : capacity_(std::max(1, _capacity)) {}
+
+  void push(int _fd);
+  bool pop(int& _fd); // false once stopped and drained
+  void stop();
+
+private:
+  const size_t capacity_;
+  bool stop_ {false};
+
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::deque<int> fds_;
+};
+
+} // namespace solveserver
+
+
+void solveserver::ConnectionQueue::push(int _fd) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this] { return fds_.size() < capacity_; });
+    fds_.push_back(_fd);
+  }
+  not_empty_.notify_one();
+} // push
+
+bool solveserver::ConnectionQueue::pop(int& _fd) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return stop_ || !fds_.empty(); });
+    if (fds_.empty())
+      return false;
+    _fd = fds_.front();
+    fds_.pop_front();
+  }
+  not_full_.notify_one();
+  return true;
+} // pop
+
+void solveserver::ConnectionQueue::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  not_empty_.notify_all();
+} // stop
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ceres/ceres.h"
+
+#include "SimpleBAL/BALManager.h"
+#include "SimpleBAL/Residual.h"
+
+#include "Residuals.h" // CurveFitting
+
+namespace solveserver {
+
+// Requests (one line each):
+//   BAL   <priority> <num_threads> <path of a BAL file>
+//   CURVE <priority> <num_threads> <x0> <y0> <x1> <y1> ...   (fits y = exp(m*x + c), as the CurveFitting tutorial)
+//   STATS
+struct JobRequest {
+  enum Type { BAL, CURVE, STATS, INVALID };
+
+  Type type {INVALID};
+  int priority {0};
+  int num_threads {1};
+  std::string path;         // BAL
+  std::vector<double> data; // CURVE, x and y interleaved
+};
+
+struct JobResult {
+  bool ok {false};
+  std::string message;
+  double initial_cost {0.0};
+  double final_cost {0.0};
+  int num_iterations {0};
+  double solve_ms {0.0};
+  std::vector<double> parameters; // CURVE: m, c
+};
+
+JobRequest parseRequest(const std::string& _line) {
+  JobRequest request;
+  std::istringstream stream(_line);
+  std::string type;
+  stream >> type;
+
+  if (type == "STATS") {
+    request.type = JobRequest::STATS;
+    return request;
+  }
+  if (!(stream >> request.priority >> request.num_threads))
+    return request;
+
+  if (type == "BAL") {
+    std::getline(stream >> std::ws, request.path); // the path may contain spaces (e.g., "3. SimpleBA")
+    if (!request.path.empty())
+      request.type = JobRequest::BAL;
+  }
+  else if (type == "CURVE") {
+    double value;
+    while (stream >> value)
+      request.data.push_back(value);
+    if (!request.data.empty() && request.data.size() % 2 == 0)
+      request.type = JobRequest::CURVE;
+  }
+  return request;
+} // parseRequest
+
+// A ceres::Problem built once over its own copy of the parameters of a cached BAL file.
+// A job checks one out, resets the parameters to the initial values of the file and solves it, 
+// thus a repeated job skips both the text parsing and the residual block construction.
+struct PreparedBALProblem {
+  explicit PreparedBALProblem(std::shared_ptr<const simplebal::BALManager> _bal);
+
+  std::shared_ptr<const simplebal::BALManager> bal;
+  std::vector<double> parameters;
+  ceres::Problem problem;
+};
+
+// Keeps the parsed BAL files, and for each of them the idle prepared problems (as many as the jobs that ran on it concurrently).
+// Each job solves a problem of its own, so a cached file is never modified.
+class BALCache {
+public:
+  explicit BALCache(int _capacity) : capacity_(std::max(1, _capacity)) {}
+
+  // nullptr (with the reason in _error) if the file can not be loaded
+  std::unique_ptr<PreparedBALProblem> acquire(const std::string& _path, std::string* _error);
+  void release(const std::string& _path, std::unique_ptr<PreparedBALProblem> _problem);
+
+  int num_hits() const { return num_hits_; }
+  int num_misses() const { return num_misses_; }
+  int num_problems_built() const { return num_problems_built_; }
+
+private:
+  struct Entry {
+    std::shared_ptr<const simplebal::BALManager> bal;
+    std::vector<std::unique_ptr<PreparedBALProblem>> idle_problems;
+  };
+
+private:
+  const int capacity_;
+  std::mutex mutex_;
+  std::list<std::string> recently_used_; // front is the most recent
+  std::map<std::string, Entry> entries_;
+  std::atomic<int> num_hits_ {0};
+  std::atomic<int> num_misses_ {0};
+  std::atomic<int> num_problems_built_ {0};
+};
+
+PreparedBALProblem::PreparedBALProblem(std::shared_ptr<const simplebal::BALManager> _bal)
+: bal(std::move(_bal)),
+  parameters(bal->parameters(), bal->parameters() + bal->num_parameters())
+{
+  double* cameras = parameters.data();
+  double* points = parameters.data() + 9*bal->num_cameras();
+  const double* observations = bal->observations();
+  for (int i = 0; i < bal->num_observations(); ++i) {
+    problem.AddResidualBlock(simplebal::genSnavelyReprojectionError(observations[2*i + 0], observations[2*i + 1]),
+                             NULL,
+                             cameras + 9*bal->camera_index(i),
+                             points + 3*bal->point_index(i));
+  }
+} // PreparedBALProblem
+
+std::unique_ptr<PreparedBALProblem> BALCache::acquire(const std::string& _path, std::string* _error) {
+  std::shared_ptr<const simplebal::BALManager> bal;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = entries_.find(_path);
+    if (found != entries_.end()) {
+      recently_used_.remove(_path);
+      recently_used_.push_front(_path);
+      num_hits_++;
+      if (!found->second.idle_problems.empty()) {
+        std::unique_ptr<PreparedBALProblem> problem = std::move(found->second.idle_problems.back());
+        found->second.idle_problems.pop_back();
+        return problem;
+      }
+      bal = found->second.bal;
+    }
+  }
+
+  // parsed (and built) outside of the lock, so the other jobs are not stalled (two concurrent misses on a file may both parse it)
+  if (!bal) {
+    auto loaded = std::make_shared<simplebal::BALManager>();
+    if (!loaded->loadFile(_path.c_str(), _error))
+      return nullptr;
+    bal = loaded;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    num_misses_++;
+    if (entries_.find(_path) == entries_.end()) {
+      entries_[_path].bal = bal;
+      recently_used_.push_front(_path);
+      if (static_cast<int>(entries_.size()) > capacity_) {
+        entries_.erase(recently_used_.back());
+        recently_used_.pop_back();
+      }
+    }
+  }
+
+  num_problems_built_++;
+  return std::unique_ptr<PreparedBALProblem>(new PreparedBALProblem(bal));
+} // acquire
+
+void BALCache::release(const std::string& _path, std::unique_ptr<PreparedBALProblem> _problem) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = entries_.find(_path);
+  // dropped if the file was evicted (or reloaded) in the meantime
+  if (found != entries_.end() && found->second.bal == _problem->bal)
+    found->second.idle_problems.push_back(std::move(_problem));
+} // release
+
+JobResult runBALJob(PreparedBALProblem& _prepared, int _num_threads) {
+  JobResult result;
+  std::copy(_prepared.bal->parameters(), _prepared.bal->parameters() + _prepared.bal->num_parameters(), _prepared.parameters.begin());
+
+  // as simplebal::setSolverOptions, but quiet and within the thread budget of the job
+  ceres::Solver::Options options;
+  options.minimizer_type = ceres::TRUST_REGION;
+  options.linear_solver_type = ceres::DENSE_SCHUR;
+  options.max_num_iterations = 200;
+  options.function_tolerance = 1e-7;
+  options.num_threads = _num_threads;
+  options.logging_type = ceres::SILENT;
+
+  ceres::Solver::Summary summary;
+  ceres::Solve(options, &_prepared.problem, &summary);
+
+  result.ok = summary.IsSolutionUsable();
+  result.message = summary.message;
+  result.initial_cost = summary.initial_cost;
+  result.final_cost = summary.final_cost;
+  result.num_iterations = static_cast<int>(summary.iterations.size());
+  result.solve_ms = 1e3 * summary.total_time_in_seconds;
+  return result;
+} // runBALJob
+
+JobResult runCurveJob(const std::vector<double>& _data, int _num_threads) {
+  JobResult result;
+  double m = 1.0;
+  double c = 1.0;
+
+  ceres::Problem problem;
+  for (size_t i = 0; i + 1 < _data.size(); i += 2)
+    problem.AddResidualBlock(genMyExponentialResidualBlock(_data[i], _data[i + 1]), new ceres::CauchyLoss(1), &m, &c);
+
+  ceres::Solver::Options options;
+  options.minimizer_type = ceres::TRUST_REGION;
+  options.linear_solver_type = ceres::DENSE_QR;
+  options.max_num_iterations = 100;
+  options.function_tolerance = 1e-7;
+  options.num_threads = _num_threads;
+  options.logging_type = ceres::SILENT;
+
+  ceres::Solver::Summary summary;
+  ceres::Solve(options, &problem, &summary);
+
+  result.ok = summary.IsSolutionUsable();
+  result.message = summary.message;
+  result.initial_cost = summary.initial_cost;
+  result.final_cost = summary.final_cost;
+  result.num_iterations = static_cast<int>(summary.iterations.size());
+  result.solve_ms = 1e3 * summary.total_time_in_seconds;
+  result.parameters = {m, c};
+  return result;
+} // runCurveJob
+
+// OK id=<job id> cost=<initial>-><final> iterations=<n> solve_ms=<ms> queue_ms=<ms> [params=<p0>,<p1>,...]
+// or ERROR <message>
+std::string formatResponse(uint64_t _job_id, const JobResult& _result, double _queue_ms) {
+  std::ostringstream response;
+  response.precision(10);
+  if (!_result.ok) {
+    response << "ERROR id=" << _job_id << " " << _result.message << "\n";
+    return response.str();
+  }
+
+  response << "OK id=" << _job_id
+           << " cost=" << _result.initial_cost << "->" << _result.final_cost
+           << " iterations=" << _result.num_iterations
+           << " solve_ms=" << _result.solve_ms
+           << " queue_ms=" << _queue_ms;
+  for (size_t i = 0; i < _result.parameters.size(); ++i)
+    response << (i == 0 ? " params=" : ",") << _result.parameters[i];
+  response << "\n";
+  return response.str();
+} // formatResponse
+
+} // namespace solveserver
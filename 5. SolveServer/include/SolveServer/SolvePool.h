@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace solveserver {
+
+// One pool of threads shared by all the jobs of the server.
+//  - a job declares a priority (higher first, FIFO among equals) and a thread budget (its Solver::Options::num_threads).
+//  - a job starts only when its budget is free, so the threads used by all the running solves never exceed the pool size.
+//  - the queue is strictly ordered: a job never overtakes a higher priority one waiting for its budget (no starvation of wide jobs).
+// Note that ceres spins up the threads of a solve itself, thus the pool shares the budget of threads rather than the threads objects.
+class SolvePool {
+public:
+  typedef std::function<void(int /* num_threads */)> Task;
+
+public:
+  explicit SolvePool(int _num_threads);
+  ~SolvePool();
+
+  void submit(int _priority, int _num_threads, Task _task);
+
+  int num_threads() const { return num_threads_; }
+  int num_queued();
+
+private:
+  struct QueuedTask {
+    int priority;
+    uint64_t sequence;
+    int num_threads;
+    Task task;
+
+    bool operator<(const QueuedTask& _other) const { // std::priority_queue pops the "largest"
+      if (priority != _other.priority)
+        return priority < _other.priority;
+      return sequence > _other.sequence;
+    }
+  };
+
+  void workerLoop();
+
+private:
+  const int num_threads_;
+  int num_free_threads_;
+  uint64_t next_sequence_ {0};
+  bool stop_ {false};
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::priority_queue<QueuedTask> queue_;
+  std::vector<std::thread> workers_;
+};
+
+} // namespace solveserver
+
+
+solveserver::SolvePool::SolvePool(int _num_threads)
+: num_threads_(std::max(1, _num_threads)),
+  num_free_threads_(std::max(1, _num_threads))
+{
+  // as many workers as threads, since that many single-threaded jobs may run at once
+  for (int i = 0; i < num_threads_; ++i)
+    workers_.emplace_back(&SolvePool::workerLoop, this);
+} // SolvePool
+
+solveserver::SolvePool::~SolvePool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_all();
+  for (auto& worker: workers_)
+    worker.join();
+} // ~SolvePool
+
+void solveserver::SolvePool::submit(int _priority, int _num_threads, Task _task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int num_threads = std::min(std::max(1, _num_threads), num_threads_); // a budget wider than the pool would never start
+    queue_.push(QueuedTask {_priority, next_sequence_++, num_threads, std::move(_task)});
+  }
+  condition_.notify_all();
+} // submit
+
+int solveserver::SolvePool::num_queued() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<int>(queue_.size());
+} // num_queued
+
+void solveserver::SolvePool::workerLoop() {
+  while (true) {
+    QueuedTask task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      // the queued jobs are drained before stopping
+      condition_.wait(lock, [this] { 
+        return (stop_ && queue_.empty()) || (!queue_.empty() && queue_.top().num_threads <= num_free_threads_); 
+      });
+      if (queue_.empty())
+        return;
+
+      task = queue_.top(); // priority_queue::top() is const, thus a copy
+      queue_.pop();
+      num_free_threads_ -= task.num_threads;
+    }
+
+    task.task(task.num_threads);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      num_free_threads_ += task.num_threads;
+    }
+    condition_.notify_all();
+  }
+} // workerLoop
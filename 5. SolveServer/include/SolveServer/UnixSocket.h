@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace solveserver {
+
+// The protocol is one request line per connection, answered by one response line.
+
+int listenUnixSocket(const std::string& _path, int _backlog = 128) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, _path.c_str(), sizeof(address.sun_path) - 1);
+
+  unlink(_path.c_str()); // a stale socket file of a previous run
+  if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, _backlog) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+} // listenUnixSocket
+
+int connectUnixSocket(const std::string& _path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, _path.c_str(), sizeof(address.sun_path) - 1);
+
+  if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+} // connectUnixSocket
+
+// Reads up to the first '\n'. A line longer than _max_size bytes is not buffered further: false, with *_too_long set,
+// so a peer that never sends a newline can not grow the buffer without bound.
+bool readLine(int _fd, std::string& _line, size_t _max_size = 1 << 20, bool* _too_long = nullptr) {
+  _line.clear();
+  if (_too_long != nullptr)
+    *_too_long = false;
+  char buffer[4096];
+  while (true) {
+    ssize_t num_read = read(_fd, buffer, sizeof(buffer));
+    if (num_read <= 0)
+      return !_line.empty();
+    const size_t searched = _line.size();
+    _line.append(buffer, num_read);
+    const size_t end = _line.find('\n', searched);
+    if (end != std::string::npos && end <= _max_size) {
+      _line.resize(end);
+      return true;
+    }
+    if (_line.size() > _max_size) {
+      _line.clear();
+      if (_too_long != nullptr)
+        *_too_long = true;
+      return false;
+    }
+  }
+} // readLine
+
+bool writeAll(int _fd, const std::string& _data) {
+  size_t num_written = 0;
+  while (num_written < _data.size()) {
+    ssize_t n = write(_fd, _data.data() + num_written, _data.size() - num_written);
+    if (n <= 0)
+      return false;
+    num_written += n;
+  }
+  return true;
+} // writeAll
+
+} // namespace solveserver
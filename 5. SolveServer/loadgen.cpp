@@ -0,0 +1,101 @@
+// Load generator for the solve server: num_clients concurrent clients submit num_jobs jobs in total 
+// (CurveFitting jobs on the bundled dataset, and a fraction of BAL jobs if --bal_file is given), 
+// then the throughput (jobs/sec) and the client / queue latencies are reported.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "SolveServer/Configurations.h"
+#include "SolveServer/UnixSocket.h"
+
+#include "data.h" // CurveFitting
+
+DEFINE_int32(num_jobs, 200, "Total number of jobs to submit.");
+DEFINE_int32(num_clients, 8, "Number of concurrent clients.");
+DEFINE_int32(job_threads, 1, "Thread budget requested by each job.");
+DEFINE_string(bal_file, "", "BAL file for the BAL jobs (none if empty).");
+DEFINE_double(bal_fraction, 0.1, "Fraction of the jobs that are BAL jobs (with --bal_file).");
+
+using Clock = std::chrono::steady_clock;
+
+double percentile(std::vector<double> _values, double _p) {
+  if (_values.empty())
+    return 0.0;
+  const size_t k = std::min(_values.size() - 1, static_cast<size_t>(_p * _values.size()));
+  std::nth_element(_values.begin(), _values.begin() + k, _values.end());
+  return _values[k];
+} // percentile
+
+int main(int argc, char** argv) 
+{
+  google::InitGoogleLogging(argv[0]);
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::ostringstream curve_request;
+  curve_request.precision(10);
+  curve_request << "CURVE 0 " << FLAGS_job_threads;
+  for (int i = 0; i < 2 * kNumObservations; ++i)
+    curve_request << " " << data[i];
+  curve_request << "\n";
+  const std::string bal_request = "BAL 1 " + std::to_string(FLAGS_job_threads) + " " + FLAGS_bal_file + "\n";
+
+  // every 1/bal_fraction-th job is a BAL job
+  const int bal_every = (!FLAGS_bal_file.empty() && FLAGS_bal_fraction > 0.0) ? std::max(1, static_cast<int>(1.0 / FLAGS_bal_fraction)) : 0;
+
+  std::atomic<int> next_job {0};
+  std::atomic<int> num_failed {0};
+  std::mutex mutex;
+  std::vector<double> latencies_ms, queue_ms;
+
+  const auto start = Clock::now();
+  std::vector<std::thread> clients;
+  for (int c = 0; c < FLAGS_num_clients; ++c) {
+    clients.emplace_back([&]() {
+      for (int job = next_job++; job < FLAGS_num_jobs; job = next_job++) {
+        const auto submitted = Clock::now();
+        const int fd = solveserver::connectUnixSocket(FLAGS_socket_path);
+        std::string response;
+        if (fd < 0 || !solveserver::writeAll(fd, (bal_every > 0 && job % bal_every == 0) ? bal_request : curve_request.str())
+                   || !solveserver::readLine(fd, response) || response.compare(0, 2, "OK") != 0) {
+          if (fd >= 0)
+            close(fd);
+          num_failed++;
+          continue;
+        }
+        close(fd);
+
+        const double latency = std::chrono::duration<double, std::milli>(Clock::now() - submitted).count();
+        double queue = 0.0;
+        const size_t found = response.find("queue_ms=");
+        if (found != std::string::npos)
+          queue = std::stod(response.substr(found + 9));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        latencies_ms.push_back(latency);
+        queue_ms.push_back(queue);
+      }
+    });
+  }
+  for (auto& client: clients)
+    client.join();
+  const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  const int num_done = static_cast<int>(latencies_ms.size());
+  printf("jobs: %d done, %d failed in %.3f sec -> %.1f jobs/sec\n", num_done, num_failed.load(), elapsed, num_done / elapsed);
+  printf("latency  (ms): p50 %8.3f  p90 %8.3f  p99 %8.3f\n", 
+         percentile(latencies_ms, 0.5), percentile(latencies_ms, 0.9), percentile(latencies_ms, 0.99));
+  printf("in queue (ms): p50 %8.3f  p90 %8.3f  p99 %8.3f\n", 
+         percentile(queue_ms, 0.5), percentile(queue_ms, 0.9), percentile(queue_ms, 0.99));
+
+  return 0;
+}
@@ -0,0 +1,162 @@
+// A long-running local solve server, so that hundreds of small-to-medium SimpleBA and CurveFitting jobs 
+// do not each pay for a process start, the data loading and the threads spin-up.
+//  - jobs arrive over a Unix domain socket (see Jobs.h for the protocol), one request per connection.
+//  - all the jobs share one thread budget (see SolvePool.h), and are scheduled by their priority.
+//  - the parsed BAL files and their built problems are cached, so a repeated job skips the parsing and the problem construction.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "SolveServer/Configurations.h"
+#include "SolveServer/ConnectionQueue.h"
+#include "SolveServer/Jobs.h"
+#include "SolveServer/SolvePool.h"
+#include "SolveServer/UnixSocket.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct ServerState {
+  explicit ServerState(int _num_threads, int _cache_size) 
+  : cache(_cache_size), start(Clock::now()), pool(_num_threads) {}
+
+  solveserver::BALCache cache;
+  const Clock::time_point start;
+  std::atomic<uint64_t> next_job_id {0};
+  std::atomic<uint64_t> num_done {0};
+  std::atomic<uint64_t> total_queue_us {0};
+  solveserver::SolvePool pool; // the last member, so its destructor finishes the queued jobs while the rest is alive
+};
+
+std::string statsResponse(ServerState& _state) {
+  const double uptime = std::chrono::duration<double>(Clock::now() - _state.start).count();
+  const uint64_t num_done = _state.num_done;
+  std::ostringstream response;
+  response << "OK jobs=" << num_done
+           << " queued=" << _state.pool.num_queued()
+           << " uptime_s=" << uptime
+           << " jobs_per_sec=" << (uptime > 0.0 ? num_done / uptime : 0.0)
+           << " mean_queue_ms=" << (num_done > 0 ? 1e-3 * _state.total_queue_us / num_done : 0.0)
+           << " cache_hits=" << _state.cache.num_hits()
+           << " cache_misses=" << _state.cache.num_misses()
+           << " problems_built=" << _state.cache.num_problems_built() << "\n";
+  return response.str();
+} // statsResponse
+
+void handleConnection(ServerState& _state, int _fd) {
+  std::string line;
+  bool too_long = false;
+  if (!solveserver::readLine(_fd, line, static_cast<size_t>(std::max(1, CERES_GET_FLAG(FLAGS_max_request_bytes))), &too_long)) {
+    if (too_long)
+      solveserver::writeAll(_fd, "ERROR request larger than --max_request_bytes\n");
+    close(_fd);
+    return;
+  }
+
+  const solveserver::JobRequest request = solveserver::parseRequest(line);
+  if (request.type == solveserver::JobRequest::STATS || request.type == solveserver::JobRequest::INVALID) {
+    solveserver::writeAll(_fd, request.type == solveserver::JobRequest::STATS ? statsResponse(_state) : std::string("ERROR invalid request\n"));
+    close(_fd);
+    return;
+  }
+
+  const uint64_t job_id = _state.next_job_id++;
+  const Clock::time_point enqueued = Clock::now();
+  _state.pool.submit(request.priority, request.num_threads, [&_state, request, job_id, enqueued, _fd](int _num_threads) {
+    const auto queue_time = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - enqueued);
+
+    solveserver::JobResult result;
+    if (request.type == solveserver::JobRequest::BAL) {
+      std::unique_ptr<solveserver::PreparedBALProblem> prepared = _state.cache.acquire(request.path, &result.message);
+      if (prepared) {
+        result = solveserver::runBALJob(*prepared, _num_threads);
+        _state.cache.release(request.path, std::move(prepared));
+      }
+    }
+    else {
+      result = solveserver::runCurveJob(request.data, _num_threads);
+    }
+
+    solveserver::writeAll(_fd, solveserver::formatResponse(job_id, result, 1e-3 * queue_time.count()));
+    close(_fd);
+
+    _state.total_queue_us += queue_time.count();
+    _state.num_done++;
+  });
+} // handleConnection
+
+int main(int argc, char** argv) 
+{
+  google::InitGoogleLogging(argv[0]);
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(CERES_GET_FLAG(FLAGS_pool_threads), 0);
+  CHECK_GT(CERES_GET_FLAG(FLAGS_connection_threads), 0);
+
+  std::signal(SIGPIPE, SIG_IGN); // a client leaving early must not kill the server
+
+  // SIGINT and SIGTERM are blocked in every thread (the threads created below inherit the mask), and taken by sigwait() in
+  // a thread of their own, which stops the accept loop, so the queued connections and jobs are drained before the exit
+  sigset_t stop_signals;
+  sigemptyset(&stop_signals);
+  sigaddset(&stop_signals, SIGINT);
+  sigaddset(&stop_signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+
+  const int listen_fd = solveserver::listenUnixSocket(CERES_GET_FLAG(FLAGS_socket_path));
+  if (listen_fd < 0) {
+    std::cerr << "ERROR: unable to listen on " << CERES_GET_FLAG(FLAGS_socket_path) << "\n";
+    return 1;
+  }
+
+  ServerState state(CERES_GET_FLAG(FLAGS_pool_threads), CERES_GET_FLAG(FLAGS_cache_size));
+  std::cout << "listening on " << CERES_GET_FLAG(FLAGS_socket_path) 
+            << " with " << state.pool.num_threads() << " threads" << std::endl;
+
+  // reading a request (which may carry a whole curve dataset) is done by a fixed set of threads, so a slow client 
+  // does not block the accept loop, and a burst of clients does not spawn a thread each
+  solveserver::ConnectionQueue connections(CERES_GET_FLAG(FLAGS_max_pending_connections));
+  std::vector<std::thread> readers;
+  for (int i = 0; i < CERES_GET_FLAG(FLAGS_connection_threads); ++i) {
+    readers.emplace_back([&state, &connections] {
+      int fd;
+      while (connections.pop(fd))
+        handleConnection(state, fd);
+    });
+  }
+
+  std::atomic<bool> stopping {false};
+  std::thread signal_waiter([&stop_signals, &stopping, listen_fd] {
+    int signal_number = 0;
+    sigwait(&stop_signals, &signal_number);
+    std::cout << "signal " << signal_number << " received, stopping" << std::endl;
+    stopping = true;
+    shutdown(listen_fd, SHUT_RDWR); // wakes up the blocked accept()
+  });
+
+  while (!stopping) {
+    const int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0)
+      continue;
+    connections.push(fd);
+  }
+
+  signal_waiter.join();
+  close(listen_fd);
+  unlink(CERES_GET_FLAG(FLAGS_socket_path).c_str());
+
+  // the readers finish the accepted connections, then the pool (in the destructor of the state) finishes their jobs
+  connections.stop();
+  for (auto& reader: readers)
+    reader.join();
+  return 0;
+}
@@ -0,0 +1,430 @@
+// Microbenchmarks of every residual in the tutorials (residual only, and residual + jacobian), 
+// and end-to-end solves on the bundled datasets. See build_and_run.sh for the json output.
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "ceres/ceres.h"
+#include "ceres/dynamic_autodiff_cost_function.h"
+
+#include "MyCostFunc.h"              // 1. HelloCeres
+#include "MyRepeatedSolver.h"        // 1. HelloCeres
+#include "Residuals.h"               // 2. CurveFitting
+#include "data.h"                    // 2. CurveFitting
+#include "Models.h"                  // 2. CurveFitting
+#include "SimpleBAL/BALManager.h"    // 3. SimpleBA
+#include "SimpleBAL/Residual.h"      // 3. SimpleBA
+#include "RobotPose1D/Residuals.h"   // 4. RobotPose1D
+#include "RobotPose1D/Robot.h"       // 4. RobotPose1D
+#include "RobotPose1D/RepeatedSolver.h" // 4. RobotPose1D
+#include "PoseGraph/Residuals.h"     // 7. PoseGraph
+#include "PoseGraph/Robot.h"         // 7. PoseGraph
+#include "PoseGraph/Optimizer.h"     // 7. PoseGraph
+#include "Profiling/ResidualProfiler.h"
+
+#ifndef BAL_DATA_FILE
+#define BAL_DATA_FILE "../../3. SimpleBA/data/problem-49-7776-pre.txt"
+#endif
+
+namespace {
+
+// Evaluates _cost_function on _parameters repeatedly, with or without the jacobians.
+void evaluateCostFunction(benchmark::State& _state, const ceres::CostFunction& _cost_function, 
+                          const std::vector<double*>& _parameters, bool _with_jacobians) {
+  const std::vector<int32_t>& block_sizes = _cost_function.parameter_block_sizes();
+  std::vector<double> residuals(_cost_function.num_residuals());
+  std::vector<std::vector<double>> jacobian_storage(block_sizes.size());
+  std::vector<double*> jacobians(block_sizes.size());
+  for (size_t i = 0; i < block_sizes.size(); ++i) {
+    jacobian_storage[i].resize(_cost_function.num_residuals() * block_sizes[i]);
+    jacobians[i] = jacobian_storage[i].data();
+  }
+
+  for (auto _ : _state) {
+    _cost_function.Evaluate(_parameters.data(), residuals.data(), _with_jacobians ? jacobians.data() : nullptr);
+    benchmark::DoNotOptimize(residuals.data());
+    benchmark::ClobberMemory();
+  }
+  _state.SetItemsProcessed(_state.iterations());
+} // evaluateCostFunction
+
+ceres::Solver::Options quietOptions(ceres::LinearSolverType _linear_solver_type) {
+  ceres::Solver::Options options;
+  options.linear_solver_type = _linear_solver_type;
+  options.logging_type = ceres::SILENT;
+  options.minimizer_progress_to_stdout = false;
+  return options;
+} // quietOptions
+
+// The resident set size now (from /proc/self/statm), and its peak so far (getrusage), in bytes.
+double residentMemoryBytes() {
+  long pages_total = 0, pages_resident = 0;
+  FILE* fptr = fopen("/proc/self/statm", "r");
+  if (fptr != NULL) {
+    if (fscanf(fptr, "%ld %ld", &pages_total, &pages_resident) != 2)
+      pages_resident = 0;
+    fclose(fptr);
+  }
+  return static_cast<double>(pages_resident) * sysconf(_SC_PAGESIZE);
+} // residentMemoryBytes
+
+double peakResidentMemoryBytes() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss * 1024.0; // kilobytes on Linux
+} // peakResidentMemoryBytes
+
+} // namespace
+
+
+// 1. HelloCeres ---------------------------------------------------------------
+
+void BM_MyCostFunc(benchmark::State& state) {
+  ceres::AutoDiffCostFunction<MyCostFunc, 1, 1> cost_function(new MyCostFunc);
+  double x = 5.0;
+  evaluateCostFunction(state, cost_function, {&x}, state.range(0));
+}
+BENCHMARK(BM_MyCostFunc)->ArgName("jacobian")->Arg(0)->Arg(1);
+
+// A solve on a new measurement, on the problem built once (MyRepeatedSolver) or rebuilt for each solve.
+void BM_RepeatedSolve_HelloCeres(benchmark::State& state) {
+  const ceres::Solver::Options options = quietOptions(ceres::DENSE_QR);
+  MyRepeatedSolver repeated_solver(options);
+  double measurement = 10.0;
+  for (auto _ : state) {
+    measurement += 1e-3;
+    ceres::Solver::Summary summary;
+    if (state.range(0)) {
+      double x = 5.0;
+      ceres::Problem problem;
+      problem.AddResidualBlock(new ceres::AutoDiffCostFunction<MyMeasuredCostFunc, 1, 1>(new MyMeasuredCostFunc(&measurement)), NULL, &x);
+      ceres::Solve(options, &problem, &summary);
+      benchmark::DoNotOptimize(x);
+    }
+    else {
+      *repeated_solver.mutable_measurement() = measurement;
+      repeated_solver.Solve(5.0, false, &summary);
+    }
+  }
+}
+BENCHMARK(BM_RepeatedSolve_HelloCeres)->ArgName("rebuild")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+void BM_Solve_HelloCeres(benchmark::State& state) {
+  for (auto _ : state) {
+    double x = 5.0;
+    ceres::Problem problem;
+    problem.AddResidualBlock(new ceres::AutoDiffCostFunction<MyCostFunc, 1, 1>(new MyCostFunc), NULL, &x);
+    ceres::Solver::Summary summary;
+    ceres::Solve(quietOptions(ceres::DENSE_QR), &problem, &summary);
+    benchmark::DoNotOptimize(x);
+  }
+}
+BENCHMARK(BM_Solve_HelloCeres)->Unit(benchmark::kMicrosecond);
+
+
+// 2. CurveFitting --------------------------------------------------------------
+
+void BM_MyExponentialResidual(benchmark::State& state) {
+  std::unique_ptr<ceres::CostFunction> cost_function(genMyExponentialResidualBlock(data[2], data[3]));
+  double m = 0.3, c = 0.1;
+  evaluateCostFunction(state, *cost_function, {&m, &c}, state.range(0));
+}
+BENCHMARK(BM_MyExponentialResidual)->ArgName("jacobian")->Arg(0)->Arg(1);
+
+void BM_Solve_CurveFitting(benchmark::State& state) {
+  for (auto _ : state) {
+    double m = 1.0, c = 1.0;
+    ceres::Problem problem;
+    for (int i = 0; i < kNumObservations; ++i)
+      problem.AddResidualBlock(genMyExponentialResidualBlock(data[2 * i], data[2 * i + 1]), new ceres::CauchyLoss(1), &m, &c);
+    ceres::Solver::Summary summary;
+    ceres::Solve(quietOptions(ceres::DENSE_QR), &problem, &summary);
+    benchmark::DoNotOptimize(m);
+  }
+}
+BENCHMARK(BM_Solve_CurveFitting)->Unit(benchmark::kMillisecond);
+
+// Fits per second of each model of Models.h on the bundled dataset (items_per_second), 
+// robust:1 is one block per sample with a CauchyLoss, robust:0 is the batched block.
+template <typename Model>
+void BM_FitModel(benchmark::State& state) {
+  ceres::Solver::Options options = quietOptions(ceres::DENSE_QR);
+  options.max_num_iterations = 100;
+  options.function_tolerance = 1e-7;
+  for (auto _ : state) {
+    CurveFitResult result = fitModel<Model>(data, kNumObservations, state.range(0), options);
+    benchmark::DoNotOptimize(result.parameters.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_FitModel, ExponentialModel)->ArgName("robust")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_FitModel, PolynomialModel<3>)->ArgName("robust")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_FitModel, GaussianModel)->ArgName("robust")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_FitModel, SumOfExponentialsModel<2>)->ArgName("robust")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_FitModel, LogisticModel)->ArgName("robust")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+// One evaluation of BatchedModelCostFunction on a dataset of `samples` samples (items_per_second counts the samples).
+// The residual-only path runs on Eigen arrays in an AVX build (the ENABLE_NATIVE_ARCH option), and on a scalar loop otherwise.
+template <typename Model>
+void BM_BatchedModelCostFunction(benchmark::State& state) {
+  const int num_samples = static_cast<int>(state.range(0));
+  std::vector<double> samples(2 * num_samples);
+  for (int i = 0; i < num_samples; ++i) {
+    samples[2*i] = data[2 * (i % kNumObservations)];
+    samples[2*i + 1] = data[2 * (i % kNumObservations) + 1];
+  }
+  BatchedModelCostFunction<Model> cost_function(samples.data(), num_samples);
+  std::array<double, Model::kNumParameters> p;
+  Model::InitialGuess(p.data());
+  evaluateCostFunction(state, cost_function, {p.data()}, state.range(1));
+  state.SetItemsProcessed(state.iterations() * num_samples);
+}
+BENCHMARK_TEMPLATE(BM_BatchedModelCostFunction, ExponentialModel)->ArgNames({"samples", "jacobian"})->ArgsProduct({{kNumObservations, 10000}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_BatchedModelCostFunction, PolynomialModel<3>)->ArgNames({"samples", "jacobian"})->ArgsProduct({{kNumObservations, 10000}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_BatchedModelCostFunction, GaussianModel)->ArgNames({"samples", "jacobian"})->ArgsProduct({{kNumObservations, 10000}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_BatchedModelCostFunction, SumOfExponentialsModel<2>)->ArgNames({"samples", "jacobian"})->ArgsProduct({{kNumObservations, 10000}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_BatchedModelCostFunction, LogisticModel)->ArgNames({"samples", "jacobian"})->ArgsProduct({{kNumObservations, 10000}, {0, 1}});
+
+
+// 3. SimpleBA ------------------------------------------------------------------
+
+void BM_SnavelyReprojectionError(benchmark::State& state) {
+  std::unique_ptr<ceres::CostFunction> cost_function(simplebal::genSnavelyReprojectionError(-332.65, 262.09));
+  // a camera 10 units behind the point along the (negative, Bundler) z axis
+  double camera[9] = {0.01, -0.02, 0.005, 0.1, -0.2, -10.0, 400.0, -1e-7, 1e-13};
+  double point[3] = {0.5, -0.3, 0.2};
+  evaluateCostFunction(state, *cost_function, {camera, point}, state.range(0));
+}
+BENCHMARK(BM_SnavelyReprojectionError)->ArgName("jacobian")->Arg(0)->Arg(1);
+
+void BM_Solve_SimpleBA(benchmark::State& state) {
+  simplebal::BALManager bal;
+  if (!bal.loadFile(BAL_DATA_FILE)) {
+    state.SkipWithError("unable to open the BAL data file");
+    return;
+  }
+  const std::vector<double> initial_parameters(bal.parameters(), bal.parameters() + bal.num_parameters());
+
+  int num_iterations = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::copy(initial_parameters.begin(), initial_parameters.end(), bal.mutable_cameras());
+    state.ResumeTiming();
+
+    ceres::Problem problem;
+    for (int i = 0; i < bal.num_observations(); ++i) {
+      problem.AddResidualBlock(simplebal::genSnavelyReprojectionError(bal.observations()[2*i + 0], bal.observations()[2*i + 1]),
+                               NULL, bal.mutable_camera_for_observation(i), bal.mutable_point_for_observation(i));
+    }
+    ceres::Solver::Options options = quietOptions(ceres::DENSE_SCHUR);
+    options.max_num_iterations = 200;
+    options.function_tolerance = 1e-7;
+    ceres::Solver::Summary summary;
+    ceres::Solve(options, &problem, &summary);
+    num_iterations = static_cast<int>(summary.iterations.size());
+  }
+  state.counters["solver_iterations"] = num_iterations;
+}
+BENCHMARK(BM_Solve_SimpleBA)->Unit(benchmark::kMillisecond);
+
+
+// 4. RobotPose1D ---------------------------------------------------------------
+
+void BM_OdometryConstraint(benchmark::State& state) {
+  std::unique_ptr<ceres::CostFunction> cost_function(rp1::OdometryConstraint::Create(0.5));
+  double odometry = 0.45;
+  evaluateCostFunction(state, *cost_function, {&odometry}, state.range(0));
+}
+BENCHMARK(BM_OdometryConstraint)->ArgName("jacobian")->Arg(0)->Arg(1);
+
+// The overhead of profiling::ResidualProfiler on the smallest and on a typical residual, against BM_OdometryConstraint and BM_SnavelyReprojectionError.
+void BM_ProfiledOdometryConstraint(benchmark::State& state) {
+  profiling::ResidualProfiler profiler;
+  std::unique_ptr<ceres::CostFunction> cost_function(profiler.wrap(rp1::OdometryConstraint::Create(0.5), "OdometryConstraint"));
+  double odometry = 0.45;
+  evaluateCostFunction(state, *cost_function, {&odometry}, state.range(0));
+}
+BENCHMARK(BM_ProfiledOdometryConstraint)->ArgName("jacobian")->Arg(0)->Arg(1);
+
+void BM_ProfiledSnavelyReprojectionError(benchmark::State& state) {
+  profiling::ResidualProfiler profiler;
+  std::unique_ptr<ceres::CostFunction> cost_function(profiler.wrap(simplebal::genSnavelyReprojectionError(-332.65, 262.09), "SnavelyReprojectionError"));
+  double camera[9] = {0.01, -0.02, 0.005, 0.1, -0.2, -10.0, 400.0, -1e-7, 1e-13};
+  double point[3] = {0.5, -0.3, 0.2};
+  evaluateCostFunction(state, *cost_function, {camera, point}, state.range(0));
+}
+BENCHMARK(BM_ProfiledSnavelyReprojectionError)->ArgName("jacobian")->Arg(0)->Arg(1);
+
+// As rp1::RangeConstraint::Create, but with the stride of the dynamic autodiff as a template argument.
+template <int kStride>
+void BM_RangeConstraint(benchmark::State& state) {
+  const int pose_index = static_cast<int>(state.range(0));
+  std::vector<double> odometry_values(pose_index + 1, 0.5);
+  std::vector<double*> parameters;
+
+  ceres::DynamicAutoDiffCostFunction<rp1::RangeConstraint, kStride> cost_function(
+      new rp1::RangeConstraint(pose_index, 10.0 - 0.5 * (pose_index + 1), 0.01, 10.0));
+  for (int i = 0; i <= pose_index; ++i) {
+    parameters.push_back(&odometry_values[i]);
+    cost_function.AddParameterBlock(1);
+  }
+  cost_function.SetNumResiduals(1);
+
+  evaluateCostFunction(state, cost_function, parameters, state.range(1));
+  state.counters["parameter_blocks"] = pose_index + 1;
+}
+BENCHMARK_TEMPLATE(BM_RangeConstraint, 4)->ArgNames({"pose_index", "jacobian"})->ArgsProduct({{0, 3, 9, 31, 63, 99, 511, 999}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_RangeConstraint, rp1::kStride)->ArgNames({"pose_index", "jacobian"})->ArgsProduct({{0, 3, 9, 31, 63, 99, 511, 999}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_RangeConstraint, 32)->ArgNames({"pose_index", "jacobian"})->ArgsProduct({{0, 3, 9, 31, 63, 99, 511, 999}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_RangeConstraint, 64)->ArgNames({"pose_index", "jacobian"})->ArgsProduct({{0, 3, 9, 31, 63, 99, 511, 999}, {0, 1}});
+
+// The dispatching factory (statically sized jets up to 64 poses, tuned dynamic stride beyond), 
+// to be compared with BM_RangeConstraint at the same pose_index.
+void BM_RangeConstraintSpecialized(benchmark::State& state) {
+  const int pose_index = static_cast<int>(state.range(0));
+  std::vector<double> odometry_values(pose_index + 1, 0.5);
+  std::vector<double*> parameters;
+
+  std::unique_ptr<ceres::CostFunction> cost_function(
+      rp1::RangeConstraint::CreateSpecialized(pose_index, 10.0 - 0.5 * (pose_index + 1), &odometry_values, &parameters));
+
+  evaluateCostFunction(state, *cost_function, parameters, state.range(1));
+  state.counters["parameter_blocks"] = pose_index + 1;
+}
+BENCHMARK(BM_RangeConstraintSpecialized)->ArgNames({"pose_index", "jacobian"})->ArgsProduct({{0, 3, 9, 31, 63, 99, 511, 999}, {0, 1}});
+
+void BM_Solve_RobotPose1D(benchmark::State& state) {
+  rp1::SetRandomState(0);
+  std::vector<double> observed_odometry, range_readings;
+  rp1::SimulateRobot(&observed_odometry, &range_readings);
+
+  for (auto _ : state) {
+    std::vector<double> odometry_values = observed_odometry;
+    ceres::Problem problem;
+    for (int i = 0; i < static_cast<int>(odometry_values.size()); ++i) {
+      std::vector<double*> parameter_blocks;
+      ceres::CostFunction* range_cost_function = state.range(0)
+          ? rp1::RangeConstraint::CreateSpecialized(i, range_readings[i], &odometry_values, &parameter_blocks)
+          : rp1::RangeConstraint::Create(i, range_readings[i], &odometry_values, &parameter_blocks);
+      problem.AddResidualBlock(range_cost_function, NULL, parameter_blocks);
+      problem.AddResidualBlock(rp1::OdometryConstraint::Create(observed_odometry[i]), NULL, &(odometry_values[i]));
+    }
+    ceres::Solver::Summary summary;
+    ceres::Solve(quietOptions(ceres::SPARSE_NORMAL_CHOLESKY), &problem, &summary);
+    benchmark::DoNotOptimize(odometry_values.data());
+  }
+}
+BENCHMARK(BM_Solve_RobotPose1D)->ArgName("specialized")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// A solve on new readings, on the problem built once (rp1::RepeatedSolver) or rebuilt for each solve.
+void BM_RepeatedSolve_RobotPose1D(benchmark::State& state) {
+  rp1::SetRandomState(0);
+  std::vector<std::vector<double>> odometry_readings(8), range_readings(8);
+  for (size_t k = 0; k < odometry_readings.size(); ++k)
+    rp1::SimulateRobot(&odometry_readings[k], &range_readings[k]);
+  const int num_poses = static_cast<int>(odometry_readings[0].size());
+
+  const ceres::Solver::Options options = quietOptions(ceres::DENSE_NORMAL_CHOLESKY);
+  rp1::RepeatedSolver repeated_solver(num_poses, options);
+  size_t k = 0;
+  for (auto _ : state) {
+    const std::vector<double>& odometry = odometry_readings[k % odometry_readings.size()];
+    const std::vector<double>& range = range_readings[k % range_readings.size()];
+    ++k;
+
+    ceres::Solver::Summary summary;
+    if (state.range(0)) {
+      std::vector<double> odometry_values = odometry;
+      ceres::Problem problem;
+      for (int i = 0; i < num_poses; ++i) {
+        std::vector<double*> parameter_blocks;
+        problem.AddResidualBlock(rp1::RangeConstraint::CreateSpecialized(i, range[i], &odometry_values, &parameter_blocks), NULL, parameter_blocks);
+        problem.AddResidualBlock(rp1::OdometryConstraint::Create(odometry[i]), NULL, &(odometry_values[i]));
+      }
+      ceres::Solve(options, &problem, &summary);
+      benchmark::DoNotOptimize(odometry_values.data());
+    }
+    else {
+      std::copy(odometry.begin(), odometry.end(), repeated_solver.mutable_odometry_readings());
+      std::copy(range.begin(), range.end(), repeated_solver.mutable_range_readings());
+      repeated_solver.Solve(false, &summary);
+    }
+  }
+}
+BENCHMARK(BM_RepeatedSolve_RobotPose1D)->ArgName("rebuild")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+
+// 7. PoseGraph -----------------------------------------------------------------
+
+void BM_PoseGraph2dErrorTerm(benchmark::State& state) {
+  pg::Constraint2d constraint {0, 1, 1.0, 0.1, 0.05, Eigen::Matrix3d::Identity()};
+  std::unique_ptr<ceres::CostFunction> cost_function(pg::PoseGraph2dErrorTerm::Create(constraint));
+  double pose_a[3] = {0.0, 0.0, 0.1};
+  double pose_b[3] = {1.1, 0.2, 0.2};
+  evaluateCostFunction(state, *cost_function, {pose_a, pose_b}, state.range(0));
+}
+BENCHMARK(BM_PoseGraph2dErrorTerm)->ArgName("jacobian")->Arg(0)->Arg(1);
+
+void BM_PoseGraph3dErrorTerm(benchmark::State& state) {
+  pg::Constraint3d constraint;
+  constraint.t_be.p = Eigen::Vector3d(1.0, 0.1, 0.0);
+  constraint.t_be.q = Eigen::Quaterniond(Eigen::AngleAxisd(0.05, Eigen::Vector3d::UnitZ()));
+  constraint.information.setIdentity();
+  std::unique_ptr<ceres::CostFunction> cost_function(pg::PoseGraph3dErrorTerm::Create(constraint));
+  pg::Pose3d a {Eigen::Vector3d(0.0, 0.0, 0.0), Eigen::Quaterniond::Identity()};
+  pg::Pose3d b {Eigen::Vector3d(1.1, 0.2, 0.1), Eigen::Quaterniond(Eigen::AngleAxisd(0.1, Eigen::Vector3d::UnitZ()))};
+  evaluateCostFunction(state, *cost_function, {a.p.data(), a.q.coeffs().data(), b.p.data(), b.q.coeffs().data()}, state.range(0));
+}
+BENCHMARK(BM_PoseGraph3dErrorTerm)->ArgName("jacobian")->Arg(0)->Arg(1);
+
+// Scaling of the sparse Cholesky solve with the number of poses (and the number of threads), on the synthetic
+// trajectories of pg::SimulateTrajectory. The solve is capped to a few iterations, the time per iteration and the
+// memory held by the problem and the solver (resident set size at the end of the solve, less the one of the graph) are reported.
+template <typename Graph>
+void BM_Solve_PoseGraph(benchmark::State& state) {
+  pg::SimulationOptions simulation;
+  simulation.num_poses = static_cast<int>(state.range(0));
+  Graph initial_graph;
+  pg::SimulateTrajectory(simulation, &initial_graph);
+
+  ceres::Solver::Options options = quietOptions(ceres::SPARSE_NORMAL_CHOLESKY);
+  pg::SetSolverOptions(&options, static_cast<int>(state.range(1)), "amd");
+  options.max_num_iterations = 10;
+
+  double seconds_per_iteration = 0.0;
+  double solver_bytes = 0.0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    Graph graph = initial_graph;
+    const double graph_bytes = residentMemoryBytes();
+    state.ResumeTiming();
+
+    ceres::Problem problem;
+    pg::BuildOptimizationProblem(&graph, &problem);
+    ceres::Solver::Summary summary;
+    ceres::Solve(options, &problem, &summary);
+
+    seconds_per_iteration = summary.minimizer_time_in_seconds / std::max<int>(1, summary.iterations.size() - 1);
+    solver_bytes = residentMemoryBytes() - graph_bytes;
+    benchmark::DoNotOptimize(graph.poses.data());
+  }
+  state.counters["constraints"] = initial_graph.constraints.size();
+  state.counters["sec_per_iteration"] = seconds_per_iteration;
+  state.counters["problem_MB"] = solver_bytes / (1024.0 * 1024.0);
+  state.counters["peak_rss_MB"] = peakResidentMemoryBytes() / (1024.0 * 1024.0);
+}
+BENCHMARK_TEMPLATE(BM_Solve_PoseGraph, pg::PoseGraph2d)->ArgNames({"poses", "threads"})
+    ->ArgsProduct({{1000, 10000, 100000}, {1, std::max<int>(1, std::thread::hardware_concurrency())}})
+    ->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Solve_PoseGraph, pg::PoseGraph3d)->ArgNames({"poses", "threads"})
+    ->ArgsProduct({{1000, 10000, 100000}, {1, std::max<int>(1, std::thread::hardware_concurrency())}})
+    ->Iterations(1)->Unit(benchmark::kMillisecond);
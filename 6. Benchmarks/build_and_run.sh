@@ -0,0 +1,10 @@
+# how to use: 
+# $ sh build_and_run.sh
+# the results are saved as json (named after the current commit), to be diffed across commits, e.g., 
+# $ python3 <google benchmark>/tools/compare.py benchmarks bench-<old>.json bench-<new>.json
+
+mkdir build 
+cd build 
+cmake ..
+make 
+./benchmarks --benchmark_out=../bench-$(git rev-parse --short HEAD).json --benchmark_out_format=json
@@ -0,0 +1,8 @@
+# how to use: 
+# $ sh build_and_run.sh
+
+mkdir build 
+cd build 
+cmake ..
+make 
+./main
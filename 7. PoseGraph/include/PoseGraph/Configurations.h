@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdio>
+#include <thread>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "ceres/ceres.h"
+
+#ifndef CERES_GET_FLAG
+#define CERES_GET_FLAG(X) X
+#endif
+
+DEFINE_string(input, "",
+              "A pose graph in the g2o or the TORO format. If empty, a synthetic trajectory is simulated.");
+
+DEFINE_int32(dimension, 2,
+             "2 for SE(2) poses, or 3 for SE(3) poses.");
+
+DEFINE_int32(num_poses, 10000,
+             "The number of poses of the synthetic trajectory.");
+
+DEFINE_int32(poses_per_lap, 100,
+             "The number of poses per lap of the synthetic trajectory, "
+             "a loop closure links each pose to the same pose of the previous lap.");
+
+DEFINE_int32(loop_closure_stride, 1,
+             "A loop closure from every k-th pose of the synthetic trajectory (0 disables them).");
+
+DEFINE_double(translation_stddev, 0.05,
+              "The standard deviation of the translation error of the synthetic measurements.");
+
+DEFINE_double(rotation_stddev, 0.01,
+              "The standard deviation of the rotation error (radians) of the synthetic measurements.");
+
+DEFINE_string(ordering, "amd",
+              "The fill-reducing ordering of the sparse Cholesky factorization, amd or nesdis "
+              "(Ceres 2.2+ built with METIS or SuiteSparse partitioning, otherwise it falls back to amd).");
+
+DEFINE_int32(num_threads, static_cast<int>(std::thread::hardware_concurrency()),
+             "The number of threads evaluating the residuals and the jacobians.");
+
+DEFINE_int32(max_num_iterations, 100,
+             "The maximum number of iterations.");
+
+DEFINE_string(output, "",
+              "If not empty, the initial and the optimized poses are written to <output>_initial.txt and <output>_optimized.txt.");
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "ceres/ceres.h"
+#include "ceres/manifold.h"
+
+#include "PoseGraph/Types.h"
+#include "PoseGraph/Residuals.h"
+
+namespace pg { // pose-graph
+
+// Adds a relative-pose residual per constraint (odometry and loop closure alike), with the pose manifolds.
+// The first pose is held constant, which fixes the gauge freedom.
+void BuildOptimizationProblem(PoseGraph2d* graph, ceres::Problem* problem);
+void BuildOptimizationProblem(PoseGraph3d* graph, ceres::Problem* problem);
+
+// Sparse Cholesky with a fill-reducing ordering ("amd", or "nesdis" if the sparse library of the Ceres build supports it,
+// the nested dissection is better on the large graphs), and the residuals and the jacobians evaluated on _num_threads threads.
+void SetSolverOptions(ceres::Solver::Options* options, int num_threads, const std::string& ordering);
+
+} // namespace pg
+
+
+void pg::BuildOptimizationProblem(PoseGraph2d* graph, ceres::Problem* problem) 
+{
+  if (graph->poses.empty())
+    return;
+
+  // a manifold can be shared by all the blocks, the problem deletes it once
+  ceres::Manifold* pose_manifold = Pose2dManifold::Create();
+  for (auto& _pose: graph->poses)
+    problem->AddParameterBlock(_pose.data, 3, pose_manifold);
+
+  for (const auto& _constraint: graph->constraints) {
+    problem->AddResidualBlock(PoseGraph2dErrorTerm::Create(_constraint), 
+                              NULL, 
+                              graph->poses[_constraint.id_begin].data, 
+                              graph->poses[_constraint.id_end].data);
+  }
+
+  problem->SetParameterBlockConstant(graph->poses.front().data);
+} // BuildOptimizationProblem
+
+void pg::BuildOptimizationProblem(PoseGraph3d* graph, ceres::Problem* problem) 
+{
+  if (graph->poses.empty())
+    return;
+
+  ceres::Manifold* quaternion_manifold = new ceres::EigenQuaternionManifold;
+  for (auto& _pose: graph->poses) {
+    problem->AddParameterBlock(_pose.p.data(), 3);
+    problem->AddParameterBlock(_pose.q.coeffs().data(), 4, quaternion_manifold);
+  }
+
+  for (const auto& _constraint: graph->constraints) {
+    Pose3d& pose_begin = graph->poses[_constraint.id_begin];
+    Pose3d& pose_end = graph->poses[_constraint.id_end];
+    problem->AddResidualBlock(PoseGraph3dErrorTerm::Create(_constraint), 
+                              NULL, 
+                              pose_begin.p.data(), pose_begin.q.coeffs().data(), 
+                              pose_end.p.data(), pose_end.q.coeffs().data());
+  }
+
+  problem->SetParameterBlockConstant(graph->poses.front().p.data());
+  problem->SetParameterBlockConstant(graph->poses.front().q.coeffs().data());
+} // BuildOptimizationProblem
+
+void pg::SetSolverOptions(ceres::Solver::Options* options, int num_threads, const std::string& ordering) 
+{
+  options->linear_solver_type = ceres::SPARSE_NORMAL_CHOLESKY;
+  options->num_threads = std::max(1, num_threads);
+#if CERES_VERSION_MAJOR > 2 || (CERES_VERSION_MAJOR == 2 && CERES_VERSION_MINOR >= 2)
+  options->linear_solver_ordering_type = (ordering == "nesdis") ? ceres::NESDIS : ceres::AMD;
+  std::string error;
+  if (options->linear_solver_ordering_type == ceres::NESDIS && !options->IsValid(&error)) {
+    std::cerr << "WARNING: the nested dissection ordering is not available (" << error << "), using AMD\n";
+    options->linear_solver_ordering_type = ceres::AMD;
+  }
+#else
+  if (ordering == "nesdis")
+    std::cerr << "WARNING: the nested dissection ordering needs Ceres 2.2, using AMD\n";
+#endif
+} // SetSolverOptions
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include "PoseGraph/Types.h"
+
+namespace pg { // pose-graph
+
+// Reads a 2D pose graph in the g2o (VERTEX_SE2 / EDGE_SE2) or the TORO (VERTEX2 / EDGE2) format,
+// or a 3D pose graph in the g2o format (VERTEX_SE3:QUAT / EDGE_SE3:QUAT). The other lines (e.g., FIX) are skipped.
+// The vertex ids do not need to be contiguous, they are mapped to the indices of the poses in the order of the file.
+bool ReadG2OFile(const std::string& filename, PoseGraph2d* graph);
+bool ReadG2OFile(const std::string& filename, PoseGraph3d* graph);
+
+// Writes the poses as "id x y yaw" (2D) or "id x y z qx qy qz qw" (3D) lines.
+bool WritePoses(const std::string& filename, const PoseGraph2d& graph);
+bool WritePoses(const std::string& filename, const PoseGraph3d& graph);
+
+namespace internal {
+
+// the edges are read before all the vertices may be known, thus their ids are mapped once the file is read
+template <typename Graph>
+bool MapVertexIds(const std::unordered_map<int, int>& id_to_index, Graph* graph) 
+{
+  for (auto& _constraint: graph->constraints) {
+    auto begin = id_to_index.find(_constraint.id_begin);
+    auto end = id_to_index.find(_constraint.id_end);
+    if (begin == id_to_index.end() || end == id_to_index.end()) {
+      std::cerr << "ERROR: an edge refers to the unknown vertex " 
+                << (begin == id_to_index.end() ? _constraint.id_begin : _constraint.id_end) << "\n";
+      return false;
+    }
+    _constraint.id_begin = begin->second;
+    _constraint.id_end = end->second;
+  }
+  return true;
+}
+
+} // namespace internal
+
+} // namespace pg
+
+
+bool pg::ReadG2OFile(const std::string& filename, PoseGraph2d* graph) 
+{
+  std::ifstream infile(filename);
+  if (!infile.is_open())
+    return false;
+
+  graph->poses.clear();
+  graph->ids.clear();
+  graph->constraints.clear();
+  std::unordered_map<int, int> id_to_index;
+
+  std::string line;
+  while (std::getline(infile, line)) {
+    std::istringstream tokens(line);
+    std::string tag;
+    tokens >> tag;
+
+    if (tag == "VERTEX_SE2" || tag == "VERTEX2") {
+      int id;
+      Pose2d pose;
+      tokens >> id >> pose.data[0] >> pose.data[1] >> pose.data[2];
+      if (tokens.fail() || id_to_index.count(id) > 0) {
+        std::cerr << "ERROR: invalid or duplicated vertex: " << line << "\n";
+        return false;
+      }
+      id_to_index[id] = static_cast<int>(graph->poses.size());
+      graph->ids.push_back(id);
+      graph->poses.push_back(pose);
+    }
+    else if (tag == "EDGE_SE2" || tag == "EDGE2") {
+      Constraint2d constraint;
+      tokens >> constraint.id_begin >> constraint.id_end >> constraint.x >> constraint.y >> constraint.yaw;
+
+      // upper triangle: g2o is xx xy xt yy yt tt, and TORO is xx xy yy tt xt yt
+      double i11, i12, i13, i22, i23, i33;
+      if (tag == "EDGE_SE2")
+        tokens >> i11 >> i12 >> i13 >> i22 >> i23 >> i33;
+      else
+        tokens >> i11 >> i12 >> i22 >> i33 >> i13 >> i23;
+      if (tokens.fail()) {
+        std::cerr << "ERROR: invalid edge: " << line << "\n";
+        return false;
+      }
+      constraint.information << i11, i12, i13, 
+                                i12, i22, i23, 
+                                i13, i23, i33;
+      graph->constraints.push_back(constraint);
+    }
+  }
+
+  return internal::MapVertexIds(id_to_index, graph);
+} // ReadG2OFile
+
+bool pg::ReadG2OFile(const std::string& filename, PoseGraph3d* graph) 
+{
+  std::ifstream infile(filename);
+  if (!infile.is_open())
+    return false;
+
+  graph->poses.clear();
+  graph->ids.clear();
+  graph->constraints.clear();
+  std::unordered_map<int, int> id_to_index;
+
+  std::string line;
+  while (std::getline(infile, line)) {
+    std::istringstream tokens(line);
+    std::string tag;
+    tokens >> tag;
+
+    if (tag == "VERTEX_SE3:QUAT") {
+      int id;
+      Pose3d pose;
+      tokens >> id >> pose.p.x() >> pose.p.y() >> pose.p.z() 
+         >> pose.q.x() >> pose.q.y() >> pose.q.z() >> pose.q.w();
+      if (tokens.fail() || id_to_index.count(id) > 0) {
+        std::cerr << "ERROR: invalid or duplicated vertex: " << line << "\n";
+        return false;
+      }
+      pose.q.normalize();
+      id_to_index[id] = static_cast<int>(graph->poses.size());
+      graph->ids.push_back(id);
+      graph->poses.push_back(pose);
+    }
+    else if (tag == "EDGE_SE3:QUAT") {
+      Constraint3d constraint;
+      tokens >> constraint.id_begin >> constraint.id_end 
+             >> constraint.t_be.p.x() >> constraint.t_be.p.y() >> constraint.t_be.p.z() 
+             >> constraint.t_be.q.x() >> constraint.t_be.q.y() >> constraint.t_be.q.z() >> constraint.t_be.q.w();
+      // the upper triangle, row by row
+      for (int i = 0; i < 6; ++i) {
+        for (int j = i; j < 6; ++j) {
+          tokens >> constraint.information(i, j);
+          constraint.information(j, i) = constraint.information(i, j);
+        }
+      }
+      if (tokens.fail()) {
+        std::cerr << "ERROR: invalid edge: " << line << "\n";
+        return false;
+      }
+      constraint.t_be.q.normalize();
+      graph->constraints.push_back(constraint);
+    }
+  }
+
+  return internal::MapVertexIds(id_to_index, graph);
+} // ReadG2OFile
+
+bool pg::WritePoses(const std::string& filename, const PoseGraph2d& graph) 
+{
+  std::ofstream outfile(filename);
+  if (!outfile.is_open())
+    return false;
+  for (size_t i = 0; i < graph.poses.size(); ++i) {
+    const Pose2d& pose = graph.poses[i];
+    outfile << graph.ids[i] << " " << pose.data[0] << " " << pose.data[1] << " " << pose.data[2] << "\n";
+  }
+  return true;
+} // WritePoses
+
+bool pg::WritePoses(const std::string& filename, const PoseGraph3d& graph) 
+{
+  std::ofstream outfile(filename);
+  if (!outfile.is_open())
+    return false;
+  for (size_t i = 0; i < graph.poses.size(); ++i) {
+    const Pose3d& pose = graph.poses[i];
+    outfile << graph.ids[i] << " " << pose.p.x() << " " << pose.p.y() << " " << pose.p.z() << " " 
+            << pose.q.x() << " " << pose.q.y() << " " << pose.q.z() << " " << pose.q.w() << "\n";
+  }
+  return true;
+} // WritePoses
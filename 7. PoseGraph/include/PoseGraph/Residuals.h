@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cmath>
+
+#include "Eigen/Cholesky"
+
+#include "ceres/ceres.h"
+#include "ceres/autodiff_manifold.h"
+
+#include "PoseGraph/Types.h"
+
+namespace pg { // pose-graph
+
+// Wraps an angle to [-pi, pi).
+template <typename T>
+inline T NormalizeAngle(const T& angle_radians) 
+{
+  using std::floor;
+  const T two_pi(2.0 * M_PI);
+  return angle_radians - two_pi * floor((angle_radians + T(M_PI)) / two_pi);
+}
+
+template <typename T>
+Eigen::Matrix<T, 2, 2> RotationMatrix2D(const T& yaw_radians) 
+{
+  using std::cos;
+  using std::sin;
+  const T cos_yaw = cos(yaw_radians);
+  const T sin_yaw = sin(yaw_radians);
+  Eigen::Matrix<T, 2, 2> rotation;
+  rotation << cos_yaw, -sin_yaw, sin_yaw, cos_yaw;
+  return rotation;
+}
+
+
+// The [x, y, yaw] block is Euclidean, except that the yaw wraps around.
+struct Pose2dManifold 
+{
+public: 
+  typedef ceres::AutoDiffManifold<Pose2dManifold, 3, 3> Pose2dAutoDiffManifold;
+
+public: 
+  template <typename T>
+  bool Plus(const T* pose, const T* delta, T* pose_plus_delta) const 
+  {
+    pose_plus_delta[0] = pose[0] + delta[0];
+    pose_plus_delta[1] = pose[1] + delta[1];
+    pose_plus_delta[2] = NormalizeAngle(pose[2] + delta[2]);
+    return true;
+  }
+
+  template <typename T>
+  bool Minus(const T* y, const T* x, T* y_minus_x) const 
+  {
+    y_minus_x[0] = y[0] - x[0];
+    y_minus_x[1] = y[1] - x[1];
+    y_minus_x[2] = NormalizeAngle(y[2] - x[2]);
+    return true;
+  }
+
+  static ceres::Manifold* Create() 
+  {
+    return new Pose2dAutoDiffManifold;
+  }
+}; // Pose2dManifold
+
+
+// residual = sqrt(information) * [ R(yaw_a)^T (p_b - p_a) - p_ab ; yaw_b - yaw_a - yaw_ab ]
+struct PoseGraph2dErrorTerm 
+{
+public: 
+  typedef ceres::AutoDiffCostFunction<PoseGraph2dErrorTerm, 3, 3, 3> PoseGraph2dCostFunction;
+
+public: 
+  PoseGraph2dErrorTerm(const Constraint2d& constraint)
+      : p_ab(constraint.x, constraint.y), 
+        yaw_ab(constraint.yaw), 
+        sqrt_information(constraint.information.llt().matrixL().transpose()) {}
+
+  template <typename T>
+  bool operator()(const T* const pose_a, const T* const pose_b, T* residuals_ptr) const 
+  {
+    const Eigen::Matrix<T, 2, 1> p_a(pose_a[0], pose_a[1]);
+    const Eigen::Matrix<T, 2, 1> p_b(pose_b[0], pose_b[1]);
+
+    Eigen::Map<Eigen::Matrix<T, 3, 1>> residuals(residuals_ptr);
+    residuals.template head<2>() = RotationMatrix2D(pose_a[2]).transpose() * (p_b - p_a) - p_ab.template cast<T>();
+    residuals(2) = NormalizeAngle((pose_b[2] - pose_a[2]) - T(yaw_ab));
+    residuals.applyOnTheLeft(sqrt_information.template cast<T>());
+    return true;
+  }
+
+  static PoseGraph2dCostFunction* Create(const Constraint2d& constraint) 
+  {
+    return new PoseGraph2dCostFunction(new PoseGraph2dErrorTerm(constraint));
+  }
+
+public: 
+  const Eigen::Vector2d p_ab;
+  const double yaw_ab;
+  const Eigen::Matrix3d sqrt_information;
+}; // PoseGraph2dErrorTerm
+
+
+// residual = sqrt(information) * [ q_a^-1 (p_b - p_a) - p_ab ; 2 vec(q_ab * (q_a^-1 q_b)^-1) ]
+struct PoseGraph3dErrorTerm 
+{
+public: 
+  typedef ceres::AutoDiffCostFunction<PoseGraph3dErrorTerm, 6, 3, 4, 3, 4> PoseGraph3dCostFunction;
+
+public: 
+  PoseGraph3dErrorTerm(const Constraint3d& constraint)
+      : t_ab(constraint.t_be), 
+        sqrt_information(constraint.information.llt().matrixL().transpose()) {}
+
+  template <typename T>
+  bool operator()(const T* const p_a_ptr, const T* const q_a_ptr,
+                  const T* const p_b_ptr, const T* const q_b_ptr,
+                  T* residuals_ptr) const 
+  {
+    Eigen::Map<const Eigen::Matrix<T, 3, 1>> p_a(p_a_ptr);
+    Eigen::Map<const Eigen::Quaternion<T>> q_a(q_a_ptr);
+    Eigen::Map<const Eigen::Matrix<T, 3, 1>> p_b(p_b_ptr);
+    Eigen::Map<const Eigen::Quaternion<T>> q_b(q_b_ptr);
+
+    const Eigen::Quaternion<T> q_a_inverse = q_a.conjugate();
+    const Eigen::Quaternion<T> q_ab_estimated = q_a_inverse * q_b;
+    const Eigen::Matrix<T, 3, 1> p_ab_estimated = q_a_inverse * (p_b - p_a);
+    const Eigen::Quaternion<T> delta_q = t_ab.q.template cast<T>() * q_ab_estimated.conjugate();
+
+    Eigen::Map<Eigen::Matrix<T, 6, 1>> residuals(residuals_ptr);
+    residuals.template block<3, 1>(0, 0) = p_ab_estimated - t_ab.p.template cast<T>();
+    residuals.template block<3, 1>(3, 0) = T(2.0) * delta_q.vec();
+    residuals.applyOnTheLeft(sqrt_information.template cast<T>());
+    return true;
+  }
+
+  static PoseGraph3dCostFunction* Create(const Constraint3d& constraint) 
+  {
+    return new PoseGraph3dCostFunction(new PoseGraph3dErrorTerm(constraint));
+  }
+
+public: 
+  const Pose3d t_ab;
+  const Eigen::Matrix<double, 6, 6> sqrt_information;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+}; // PoseGraph3dErrorTerm
+
+} // namespace pg
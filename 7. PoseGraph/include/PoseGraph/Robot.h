@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cmath>
+#include <random>
+
+#include "PoseGraph/Types.h"
+#include "PoseGraph/Residuals.h"
+
+namespace pg { // pose-graph
+
+// A synthetic trajectory that drives around the same loop (2D, a circle) or climbs a helix (3D),
+// with a noisy odometry between successive poses and a noisy loop closure to the pose of the previous lap.
+// The initial values are the dead reckoning of the noisy odometry, so the drift grows along the trajectory.
+struct SimulationOptions 
+{
+  int num_poses {1000};
+  int poses_per_lap {100};
+  int loop_closure_stride {1};        // a loop closure from every k-th pose (0 disables them)
+  double pose_separation {1.0};       // meters between successive poses
+  double lap_height {2.0};            // (3D) meters climbed per lap
+  double translation_stddev {0.05};   // meters
+  double rotation_stddev {0.01};      // radians
+  unsigned int seed {0};
+}; // SimulationOptions
+
+void SimulateTrajectory(const SimulationOptions& options, PoseGraph2d* graph, PoseGraph2d* ground_truth = nullptr);
+void SimulateTrajectory(const SimulationOptions& options, PoseGraph3d* graph, PoseGraph3d* ground_truth = nullptr);
+
+} // namespace pg
+
+
+void pg::SimulateTrajectory(const SimulationOptions& options, PoseGraph2d* graph, PoseGraph2d* ground_truth) 
+{
+  std::mt19937 random(options.seed);
+  std::normal_distribution<double> translation_noise(0.0, options.translation_stddev);
+  std::normal_distribution<double> rotation_noise(0.0, options.rotation_stddev);
+
+  const double radius = options.poses_per_lap * options.pose_separation / (2.0 * M_PI);
+  std::vector<Pose2d> truth(options.num_poses);
+  for (int i = 0; i < options.num_poses; ++i) {
+    const double angle = 2.0 * M_PI * (i % options.poses_per_lap) / options.poses_per_lap;
+    truth[i] = Pose2d {{radius * std::sin(angle), radius * (1.0 - std::cos(angle)), NormalizeAngle(angle)}};
+  }
+
+  Eigen::Matrix3d information = Eigen::Matrix3d::Zero();
+  information(0, 0) = information(1, 1) = 1.0 / (options.translation_stddev * options.translation_stddev);
+  information(2, 2) = 1.0 / (options.rotation_stddev * options.rotation_stddev);
+
+  auto measure = [&](int _begin, int _end) {
+    const Pose2d& a = truth[_begin];
+    const Pose2d& b = truth[_end];
+    const Eigen::Vector2d p_ab = RotationMatrix2D(a.data[2]).transpose() 
+                               * Eigen::Vector2d(b.data[0] - a.data[0], b.data[1] - a.data[1]);
+    return Constraint2d {_begin, _end, 
+                         p_ab.x() + translation_noise(random), 
+                         p_ab.y() + translation_noise(random), 
+                         NormalizeAngle(b.data[2] - a.data[2] + rotation_noise(random)), 
+                         information};
+  };
+
+  graph->poses.assign(options.num_poses, truth[0]);
+  graph->ids.resize(options.num_poses);
+  graph->constraints.clear();
+  for (int i = 0; i < options.num_poses; ++i) {
+    graph->ids[i] = i;
+    if (i == 0)
+      continue;
+
+    // dead reckoning
+    const Constraint2d odometry = measure(i - 1, i);
+    const Pose2d& previous = graph->poses[i - 1];
+    const Eigen::Vector2d p = Eigen::Vector2d(previous.data[0], previous.data[1]) 
+                            + RotationMatrix2D(previous.data[2]) * Eigen::Vector2d(odometry.x, odometry.y);
+    graph->poses[i] = Pose2d {{p.x(), p.y(), NormalizeAngle(previous.data[2] + odometry.yaw)}};
+    graph->constraints.push_back(odometry);
+
+    if (options.loop_closure_stride > 0 && i >= options.poses_per_lap && i % options.loop_closure_stride == 0)
+      graph->constraints.push_back(measure(i - options.poses_per_lap, i));
+  }
+
+  if (ground_truth != nullptr) {
+    ground_truth->poses = truth;
+    ground_truth->ids = graph->ids;
+    ground_truth->constraints.clear();
+  }
+} // SimulateTrajectory
+
+void pg::SimulateTrajectory(const SimulationOptions& options, PoseGraph3d* graph, PoseGraph3d* ground_truth) 
+{
+  std::mt19937 random(options.seed);
+  std::normal_distribution<double> translation_noise(0.0, options.translation_stddev);
+  std::normal_distribution<double> rotation_noise(0.0, options.rotation_stddev);
+
+  const double radius = options.poses_per_lap * options.pose_separation / (2.0 * M_PI);
+  std::vector<Pose3d, Eigen::aligned_allocator<Pose3d>> truth(options.num_poses);
+  for (int i = 0; i < options.num_poses; ++i) {
+    const double angle = 2.0 * M_PI * i / options.poses_per_lap;
+    truth[i].p = Eigen::Vector3d(radius * std::sin(angle), radius * (1.0 - std::cos(angle)), options.lap_height * i / options.poses_per_lap);
+    truth[i].q = Eigen::Quaterniond(Eigen::AngleAxisd(angle, Eigen::Vector3d::UnitZ()));
+  }
+
+  Eigen::Matrix<double, 6, 6> information = Eigen::Matrix<double, 6, 6>::Zero();
+  information.diagonal().head<3>().setConstant(1.0 / (options.translation_stddev * options.translation_stddev));
+  information.diagonal().tail<3>().setConstant(1.0 / (options.rotation_stddev * options.rotation_stddev));
+
+  auto measure = [&](int _begin, int _end) {
+    const Pose3d& a = truth[_begin];
+    const Pose3d& b = truth[_end];
+    Constraint3d constraint;
+    constraint.id_begin = _begin;
+    constraint.id_end = _end;
+    constraint.t_be.p = a.q.conjugate() * (b.p - a.p) 
+                      + Eigen::Vector3d(translation_noise(random), translation_noise(random), translation_noise(random));
+    const Eigen::Vector3d rotation_error(rotation_noise(random), rotation_noise(random), rotation_noise(random));
+    const Eigen::Quaterniond delta_q(1.0, 0.5 * rotation_error.x(), 0.5 * rotation_error.y(), 0.5 * rotation_error.z());
+    constraint.t_be.q = ((a.q.conjugate() * b.q) * delta_q).normalized();
+    constraint.information = information;
+    return constraint;
+  };
+
+  graph->poses.assign(options.num_poses, truth[0]);
+  graph->ids.resize(options.num_poses);
+  graph->constraints.clear();
+  for (int i = 0; i < options.num_poses; ++i) {
+    graph->ids[i] = i;
+    if (i == 0)
+      continue;
+
+    // dead reckoning
+    const Constraint3d odometry = measure(i - 1, i);
+    const Pose3d& previous = graph->poses[i - 1];
+    graph->poses[i].p = previous.p + previous.q * odometry.t_be.p;
+    graph->poses[i].q = (previous.q * odometry.t_be.q).normalized();
+    graph->constraints.push_back(odometry);
+
+    if (options.loop_closure_stride > 0 && i >= options.poses_per_lap && i % options.loop_closure_stride == 0)
+      graph->constraints.push_back(measure(i - options.poses_per_lap, i));
+  }
+
+  if (ground_truth != nullptr) {
+    ground_truth->poses = truth;
+    ground_truth->ids = graph->ids;
+    ground_truth->constraints.clear();
+  }
+} // SimulateTrajectory
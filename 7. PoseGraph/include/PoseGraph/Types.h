@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+
+#include "Eigen/Core"
+#include "Eigen/Geometry"
+#include "Eigen/StdVector"
+
+namespace pg { // pose-graph
+
+// SE(2) pose, stored as a single parameter block of [x, y, yaw].
+struct Pose2d 
+{
+  double data[3]; // x, y, yaw (radians, in [-pi, pi))
+}; // Pose2d
+
+// Relative pose of id_end in the frame of id_begin, for the odometry and the loop closures alike.
+struct Constraint2d 
+{
+  int id_begin; // indices into PoseGraph2d::poses
+  int id_end;
+  double x, y, yaw;
+  Eigen::Matrix3d information; // in the order of x, y, yaw
+}; // Constraint2d
+
+struct PoseGraph2d 
+{
+  std::vector<Pose2d> poses;
+  std::vector<int> ids; // the vertex id of each pose in the input file
+  std::vector<Constraint2d> constraints;
+}; // PoseGraph2d
+
+
+// SE(3) pose, stored as two parameter blocks: the position and the unit quaternion (Eigen order, x y z w).
+struct Pose3d 
+{
+  Eigen::Vector3d p;
+  Eigen::Quaterniond q;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+}; // Pose3d
+
+struct Constraint3d 
+{
+  int id_begin; // indices into PoseGraph3d::poses
+  int id_end;
+  Pose3d t_be; // the pose of id_end in the frame of id_begin
+  Eigen::Matrix<double, 6, 6> information; // in the order of x, y, z, and the rotation delta_x, delta_y, delta_z
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+}; // Constraint3d
+
+struct PoseGraph3d 
+{
+  std::vector<Pose3d, Eigen::aligned_allocator<Pose3d>> poses;
+  std::vector<int> ids;
+  std::vector<Constraint3d, Eigen::aligned_allocator<Constraint3d>> constraints;
+}; // PoseGraph3d
+
+} // namespace pg
@@ -0,0 +1,91 @@
+// A pose-graph SLAM backend on the structure of 4. RobotPose1D, after the pose_graph_2d and pose_graph_3d examples of Ceres.
+//
+// The robot poses are SE(2) ([x, y, yaw] with the yaw wrapping around) or SE(3) (a position and a unit quaternion),
+// and every edge of the graph, an odometry between successive poses or a loop closure, is a relative-pose residual
+// weighted by the square root of its information matrix:
+//
+//   SE(2): r = sqrt(I) * [ R(yaw_a)^T (p_b - p_a) - p_ab ; yaw_b - yaw_a - yaw_ab ]
+//   SE(3): r = sqrt(I) * [ q_a^-1 (p_b - p_a) - p_ab ; 2 vec(q_ab * (q_a^-1 q_b)^-1) ]
+//
+// The graph is either read from a g2o/TORO file (--input), or simulated (--num_poses) as a trajectory driving around
+// the same loop with a loop closure to the previous lap, and initialized by the dead reckoning of its noisy odometry.
+// Each pose only touches its neighbours in the graph, thus the normal equations are very sparse, and they are solved
+// with the sparse Cholesky factorization after a fill-reducing ordering (--ordering).
+
+#include <sys/resource.h>
+
+#include <string>
+
+#include "PoseGraph/Configurations.h"
+#include "PoseGraph/Types.h"
+#include "PoseGraph/Residuals.h"
+#include "PoseGraph/ReadG2O.h"
+#include "PoseGraph/Robot.h"
+#include "PoseGraph/Optimizer.h"
+
+template <typename Graph>
+int SolvePoseGraph(Graph* graph) 
+{
+  std::cout << "poses: " << graph->poses.size() << ", constraints: " << graph->constraints.size() << "\n";
+  if (!CERES_GET_FLAG(FLAGS_output).empty())
+    pg::WritePoses(CERES_GET_FLAG(FLAGS_output) + "_initial.txt", *graph);
+
+  ceres::Problem problem;
+  pg::BuildOptimizationProblem(graph, &problem);
+
+  ceres::Solver::Options solver_options;
+  pg::SetSolverOptions(&solver_options, CERES_GET_FLAG(FLAGS_num_threads), CERES_GET_FLAG(FLAGS_ordering));
+  solver_options.max_num_iterations = CERES_GET_FLAG(FLAGS_max_num_iterations);
+  solver_options.minimizer_progress_to_stdout = true;
+
+  ceres::Solver::Summary summary;
+  ceres::Solve(solver_options, &problem, &summary);
+  std::cout << summary.FullReport() << "\n";
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  const int num_iterations = std::max(1, static_cast<int>(summary.iterations.size()) - 1); // the first entry is the initial state
+  printf("time per iteration: %.3f sec (%d threads), peak memory: %.1f MB\n", 
+         summary.minimizer_time_in_seconds / num_iterations, summary.num_threads_used, usage.ru_maxrss / 1024.0);
+
+  if (!CERES_GET_FLAG(FLAGS_output).empty())
+    pg::WritePoses(CERES_GET_FLAG(FLAGS_output) + "_optimized.txt", *graph);
+  return summary.IsSolutionUsable() ? 0 : 1;
+}
+
+template <typename Graph>
+int LoadAndSolve() 
+{
+  Graph graph;
+  if (!CERES_GET_FLAG(FLAGS_input).empty()) {
+    if (!pg::ReadG2OFile(CERES_GET_FLAG(FLAGS_input), &graph)) {
+      std::cerr << "ERROR: unable to read " << CERES_GET_FLAG(FLAGS_input) << "\n";
+      return 1;
+    }
+  }
+  else {
+    pg::SimulationOptions simulation;
+    simulation.num_poses = CERES_GET_FLAG(FLAGS_num_poses);
+    simulation.poses_per_lap = CERES_GET_FLAG(FLAGS_poses_per_lap);
+    simulation.loop_closure_stride = CERES_GET_FLAG(FLAGS_loop_closure_stride);
+    simulation.translation_stddev = CERES_GET_FLAG(FLAGS_translation_stddev);
+    simulation.rotation_stddev = CERES_GET_FLAG(FLAGS_rotation_stddev);
+    pg::SimulateTrajectory(simulation, &graph);
+  }
+  return SolvePoseGraph(&graph);
+}
+
+int main(int argc, char** argv) 
+{
+  google::InitGoogleLogging(argv[0]);
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK(CERES_GET_FLAG(FLAGS_dimension) == 2 || CERES_GET_FLAG(FLAGS_dimension) == 3);
+  CHECK_GT(CERES_GET_FLAG(FLAGS_num_poses), 0);
+  CHECK_GT(CERES_GET_FLAG(FLAGS_poses_per_lap), 1);
+  CHECK_GT(CERES_GET_FLAG(FLAGS_translation_stddev), 0.0);
+  CHECK_GT(CERES_GET_FLAG(FLAGS_rotation_stddev), 0.0);
+
+  if (CERES_GET_FLAG(FLAGS_dimension) == 2)
+    return LoadAndSolve<pg::PoseGraph2d>();
+  return LoadAndSolve<pg::PoseGraph3d>();
+}
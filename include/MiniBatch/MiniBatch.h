@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+#include "ceres/ceres.h"
+
+namespace minibatch {
+
+// The options and the phase statistics of the stochastic mini-batch warm phase, shared by 2. CurveFitting (MiniBatch.h,
+// on the samples) and 3. SimpleBA (SimpleBAL/MiniBatch.h, on the observations): the first phases solve a few iterations
+// on growing random subsets of the residuals, resampled in each phase, and the final phase runs on the full problem.
+struct MiniBatchOptions {
+  double initial_fraction {0.05}; // of the residuals in the first phase
+  double growth {3.0};            // the fraction is multiplied by this after each phase, until it reaches the full problem
+  int phase_max_iterations {5};
+  int min_batch_size {20};        // a smaller subset is grown to this size (the phases stop once it is the full problem)
+  unsigned int seed {0};
+};
+
+struct MiniBatchPhaseStats {
+  int batch_size;
+  int num_iterations;
+  double time_in_seconds; // sampling + construction + solve
+  double final_cost;      // of the phase problem (the final phase is the full problem)
+};
+
+// The minimizer time until the cost first reached _cost (until the last iteration if it never did), to compare two runs
+// at an equal cost. Both cases read the cumulative time of the iterations, thus the preprocessing is never included.
+inline double timeToCost(const ceres::Solver::Summary& _summary, double _cost) {
+  for (auto& _iteration: _summary.iterations) {
+    if (_iteration.cost <= _cost)
+      return _iteration.cumulative_time_in_seconds;
+  }
+  return _summary.iterations.empty() ? 0.0 : _summary.iterations.back().cumulative_time_in_seconds;
+}
+
+} // namespace minibatch
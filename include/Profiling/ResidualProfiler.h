@@ -0,0 +1,314 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <vector>
+
+#ifdef ENABLE_RESIDUAL_PROFILER
+#include <cxxabi.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+#include "ceres/ceres.h"
+
+namespace profiling {
+
+// Per-residual-type evaluation profiler: ResidualProfiler::wrap() puts a ProfiledCostFunction around any cost function
+// before it is added to the problem, and report() prints, after the solve, the call counts and the latency histogram of
+// each cost function type (sorted by the total time), and optionally the top-K slowest residual blocks.
+//
+// It is compiled in with -DENABLE_RESIDUAL_PROFILER (the ENABLE_RESIDUAL_PROFILER option of the CMakeLists), otherwise
+// wrap() returns the cost function as it is, and the solve is exactly the one without the profiler.
+//
+// The latencies are taken with the TSC where it is available (converted with the steady_clock over the profiler's
+// lifetime), else with the steady_clock. Every evaluation thread increments its own plain counters (no atomics, no
+// shared cache lines), and report() merges them, thus report() must not run concurrently with a solve.
+class ResidualProfiler {
+public:
+  explicit ResidualProfiler(int _top_k = 0);
+
+  // Takes the ownership of _cost_function, and returns the cost function to be added to the problem (which owns it then).
+  // The type name defaults to the demangled type of the cost function.
+  ceres::CostFunction* wrap(ceres::CostFunction* _cost_function, const std::string& _type_name = "");
+
+  void report(std::ostream& _out) const;
+
+  static constexpr bool enabled() {
+#ifdef ENABLE_RESIDUAL_PROFILER
+    return true;
+#else
+    return false;
+#endif
+  }
+
+#ifdef ENABLE_RESIDUAL_PROFILER
+public:
+  static constexpr int kNumBuckets = 32; // bucket b holds the latencies in [2^(b-1), 2^b) ticks
+
+  struct BlockCounters {
+    uint64_t calls {0};
+    uint64_t jacobian_calls {0};
+    uint64_t ticks {0};
+    uint64_t max_ticks {0};
+  };
+
+  // The counters of one evaluation thread, written only by that thread (and grown on demand).
+  struct ThreadCounters {
+    std::vector<BlockCounters> blocks; // by block id
+    std::vector<uint64_t> buckets;     // kNumBuckets per type id
+  };
+
+  static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+  void record(int _block, int _type, uint64_t _ticks, bool _jacobian) {
+    ThreadCounters& counters = countersOfThisThread();
+    if (static_cast<size_t>(_block) >= counters.blocks.size())
+      counters.blocks.resize(_block + 1);
+    if (static_cast<size_t>(_type + 1) * kNumBuckets > counters.buckets.size())
+      counters.buckets.resize(static_cast<size_t>(_type + 1) * kNumBuckets, 0);
+
+    BlockCounters& block = counters.blocks[_block];
+    block.calls += 1;
+    block.jacobian_calls += _jacobian ? 1 : 0;
+    block.ticks += _ticks;
+    block.max_ticks = std::max(block.max_ticks, _ticks);
+    counters.buckets[_type * kNumBuckets + std::min(kNumBuckets - 1, 64 - __builtin_clzll(_ticks | 1))] += 1;
+  }
+
+private:
+  struct BlockInfo {
+    int type;
+    int index; // the registration order within its type
+  };
+
+  static uint64_t nextId() {
+    static std::atomic<uint64_t> next_id {1};
+    return next_id.fetch_add(1);
+  }
+
+  // A thread caches the counters of the last profiler it recorded to (by id, not by address, which a later profiler
+  // may reuse), so the mutex is only taken by the first evaluation of each thread (and when it alternates profilers).
+  ThreadCounters& countersOfThisThread() {
+    struct Cache {
+      uint64_t profiler_id;
+      ThreadCounters* counters;
+    };
+    static thread_local Cache cache {0, nullptr};
+    if (cache.profiler_id != id_) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::unique_ptr<ThreadCounters>& counters = threads_[std::this_thread::get_id()];
+      if (!counters)
+        counters.reset(new ThreadCounters());
+      cache = Cache {id_, counters.get()};
+    }
+    return *cache.counters;
+  }
+
+  double nanosecondsPerTick() const;
+
+private:
+  const uint64_t id_;
+  int top_k_;
+  const uint64_t start_ticks_;
+  const std::chrono::steady_clock::time_point start_time_;
+
+  mutable std::mutex mutex_; // guards the registration of the blocks and of the threads, not the counters
+  std::vector<std::string> types_;
+  std::map<std::string, int> types_by_name_;
+  std::vector<int> num_blocks_by_type_;
+  std::vector<BlockInfo> blocks_;
+  std::map<std::thread::id, std::unique_ptr<ThreadCounters>> threads_; // the threads of a finished solve keep their counters
+#endif
+}; // ResidualProfiler
+
+#ifdef ENABLE_RESIDUAL_PROFILER
+// Forwards Evaluate() to the wrapped cost function, and records its latency.
+class ProfiledCostFunction : public ceres::CostFunction {
+public:
+  ProfiledCostFunction(ceres::CostFunction* _cost_function, ResidualProfiler* _profiler, int _block, int _type) 
+  : cost_function_(_cost_function), profiler_(_profiler), block_(_block), type_(_type) {
+    *mutable_parameter_block_sizes() = cost_function_->parameter_block_sizes();
+    set_num_residuals(cost_function_->num_residuals());
+  }
+
+  bool Evaluate(double const* const* _parameters, double* _residuals, double** _jacobians) const override {
+    const uint64_t start = ResidualProfiler::now();
+    const bool success = cost_function_->Evaluate(_parameters, _residuals, _jacobians);
+    profiler_->record(block_, type_, ResidualProfiler::now() - start, _jacobians != nullptr);
+    return success;
+  }
+
+private:
+  std::unique_ptr<ceres::CostFunction> cost_function_;
+  ResidualProfiler* profiler_;
+  const int block_;
+  const int type_;
+}; // ProfiledCostFunction
+#endif
+
+} // namespace profiling
+
+
+#ifdef ENABLE_RESIDUAL_PROFILER
+
+profiling::ResidualProfiler::ResidualProfiler(int _top_k)
+: id_(nextId()), top_k_(_top_k), start_ticks_(now()), start_time_(std::chrono::steady_clock::now()) {
+} // ResidualProfiler
+
+ceres::CostFunction* profiling::ResidualProfiler::wrap(ceres::CostFunction* _cost_function, const std::string& _type_name) {
+  std::string name = _type_name;
+  if (name.empty()) {
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(typeid(*_cost_function).name(), nullptr, nullptr, &status);
+    name = (status == 0 && demangled != nullptr) ? demangled : typeid(*_cost_function).name();
+    free(demangled);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int type = types_by_name_.emplace(name, static_cast<int>(types_.size())).first->second;
+  if (type == static_cast<int>(types_.size())) {
+    types_.push_back(name);
+    num_blocks_by_type_.push_back(0);
+  }
+
+  const int block = static_cast<int>(blocks_.size());
+  blocks_.push_back(BlockInfo {type, num_blocks_by_type_[type]++});
+  return new ProfiledCostFunction(_cost_function, this, block, type);
+} // wrap
+
+double profiling::ResidualProfiler::nanosecondsPerTick() const {
+#if defined(__x86_64__) || defined(__i386__)
+  const uint64_t ticks = now() - start_ticks_;
+  const double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time_).count();
+  return (ticks > 0) ? nanoseconds / ticks : 1.0;
+#else
+  return 1.0;
+#endif
+} // nanosecondsPerTick
+
+void profiling::ResidualProfiler::report(std::ostream& _out) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const double ns_per_tick = nanosecondsPerTick();
+
+  // merges the counters of all the threads
+  std::vector<BlockCounters> blocks(blocks_.size());
+  std::vector<uint64_t> buckets(types_.size() * kNumBuckets, 0);
+  for (const auto& _thread: threads_) {
+    const ThreadCounters& counters = *_thread.second;
+    for (size_t i = 0; i < counters.blocks.size(); ++i) {
+      blocks[i].calls += counters.blocks[i].calls;
+      blocks[i].jacobian_calls += counters.blocks[i].jacobian_calls;
+      blocks[i].ticks += counters.blocks[i].ticks;
+      blocks[i].max_ticks = std::max(blocks[i].max_ticks, counters.blocks[i].max_ticks);
+    }
+    for (size_t i = 0; i < counters.buckets.size(); ++i)
+      buckets[i] += counters.buckets[i];
+  }
+
+  struct TypeSummary {
+    int type;
+    uint64_t blocks {0}, calls {0}, jacobian_calls {0}, ticks {0};
+  };
+  std::vector<TypeSummary> sorted(types_.size());
+  uint64_t total_ticks = 0;
+  for (size_t t = 0; t < types_.size(); ++t)
+    sorted[t].type = static_cast<int>(t);
+  for (size_t i = 0; i < blocks_.size(); ++i) {
+    TypeSummary& summary = sorted[blocks_[i].type];
+    summary.blocks += 1;
+    summary.calls += blocks[i].calls;
+    summary.jacobian_calls += blocks[i].jacobian_calls;
+    summary.ticks += blocks[i].ticks;
+    total_ticks += blocks[i].ticks;
+  }
+  std::sort(sorted.begin(), sorted.end(), [](const TypeSummary& _a, const TypeSummary& _b) { return _a.ticks > _b.ticks; });
+
+  // the upper bound of the bucket holding the given fraction of the calls
+  auto percentile = [&](const TypeSummary& _summary, double _fraction) {
+    uint64_t count = 0;
+    for (int b = 0; b < kNumBuckets; ++b) {
+      count += buckets[_summary.type * kNumBuckets + b];
+      if (count >= _fraction * _summary.calls)
+        return static_cast<double>(uint64_t(1) << b) * ns_per_tick;
+    }
+    return static_cast<double>(uint64_t(1) << (kNumBuckets - 1)) * ns_per_tick;
+  };
+
+  char line[512];
+  _out << "\nResidual evaluation profile (sorted by the total time)\n";
+  snprintf(line, sizeof(line), "%-64s %8s %12s %10s %11s %7s %10s %10s %10s\n", 
+           "type", "blocks", "calls", "jacobian%", "total(ms)", "share%", "mean(ns)", "p50(ns)<", "p99(ns)<");
+  _out << line;
+  for (const auto& _summary: sorted) {
+    const double total_ns = _summary.ticks * ns_per_tick;
+    snprintf(line, sizeof(line), "%-64.64s %8llu %12llu %10.1f %11.3f %7.1f %10.1f %10.0f %10.0f\n",
+             types_[_summary.type].c_str(), 
+             static_cast<unsigned long long>(_summary.blocks), static_cast<unsigned long long>(_summary.calls),
+             (_summary.calls > 0) ? 100.0 * _summary.jacobian_calls / _summary.calls : 0.0,
+             total_ns * 1e-6, (total_ticks > 0) ? 100.0 * _summary.ticks / total_ticks : 0.0,
+             (_summary.calls > 0) ? total_ns / _summary.calls : 0.0, 
+             percentile(_summary, 0.5), percentile(_summary, 0.99));
+    _out << line;
+  }
+
+  if (top_k_ <= 0 || blocks_.empty())
+    return;
+
+  // the slowest blocks by the mean latency
+  std::vector<int> slowest;
+  for (size_t i = 0; i < blocks.size(); ++i)
+    if (blocks[i].calls > 0)
+      slowest.push_back(static_cast<int>(i));
+  auto mean_ticks = [&](int _block) {
+    return static_cast<double>(blocks[_block].ticks) / blocks[_block].calls;
+  };
+  const size_t top_k = std::min(slowest.size(), static_cast<size_t>(top_k_));
+  std::partial_sort(slowest.begin(), slowest.begin() + top_k, slowest.end(), 
+                    [&](int _a, int _b) { return mean_ticks(_a) > mean_ticks(_b); });
+
+  _out << "\nTop " << top_k << " slowest residual blocks (by the mean latency)\n";
+  snprintf(line, sizeof(line), "%-64s %8s %12s %10s %10s\n", "type", "block", "calls", "mean(ns)", "max(ns)");
+  _out << line;
+  for (size_t i = 0; i < top_k; ++i) {
+    const int block = slowest[i];
+    snprintf(line, sizeof(line), "%-64.64s %8d %12llu %10.1f %10.1f\n", 
+             types_[blocks_[block].type].c_str(), blocks_[block].index, 
+             static_cast<unsigned long long>(blocks[block].calls),
+             mean_ticks(block) * ns_per_tick, blocks[block].max_ticks * ns_per_tick);
+    _out << line;
+  }
+} // report
+
+#else // ENABLE_RESIDUAL_PROFILER
+
+profiling::ResidualProfiler::ResidualProfiler(int) {
+} // ResidualProfiler
+
+ceres::CostFunction* profiling::ResidualProfiler::wrap(ceres::CostFunction* _cost_function, const std::string&) {
+  return _cost_function;
+} // wrap
+
+void profiling::ResidualProfiler::report(std::ostream& _out) const {
+  _out << "\nResidual evaluation profile: compiled out, build with -DENABLE_RESIDUAL_PROFILER=ON\n";
+} // report
+
+#endif // ENABLE_RESIDUAL_PROFILER